@@ -1,10 +1,13 @@
 #pragma once
 #include "math.hpp"
 
-struct Body {
-    Vec3D position;
-    Vec3D velocity;
-    float mass;
-    float radius;
+template <typename T>
+struct BasicBody {
+    Vec3<T> position;
+    Vec3<T> velocity;
+    T mass;
+    T radius;
 };
 
+using Body = BasicBody<float>;
+using BodyD = BasicBody<double>;
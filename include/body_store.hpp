@@ -0,0 +1,120 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "body.hpp"
+
+constexpr std::size_t SIMD_ALIGNMENT = 32;
+
+template <typename T, std::size_t Align = SIMD_ALIGNMENT>
+struct AlignedAllocator {
+    using value_type = T;
+
+    template <typename U>
+    struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template <typename U>
+    AlignedAllocator(const AlignedAllocator<U, Align>&) {}
+
+    T* allocate(std::size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+
+    void deallocate(T* p, std::size_t) {
+        ::operator delete(p, std::align_val_t(Align));
+    }
+
+    template <typename U>
+    bool operator==(const AlignedAllocator<U, Align>&) const { return true; }
+    template <typename U>
+    bool operator!=(const AlignedAllocator<U, Align>&) const { return false; }
+};
+
+template <typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+// Single keeps the whole state in float. Mixed keeps positions and
+// velocities in double as well, so drift and kick accumulate in double
+// while the force kernels still stream the rounded float copies.
+enum class Precision {
+    Single,
+    Mixed
+};
+
+const char* precisionName(Precision precision);
+
+// Read-only view of the arrays needed to draw a body set.
+struct BodyView {
+    const float* x;
+    const float* y;
+    const float* z;
+    const float* radius;
+    std::size_t count;
+};
+
+// Structure-of-arrays body storage. Every component is its own aligned,
+// contiguous float array so the force kernels can stream it through
+// vector registers. Use get/set/add for single-body access through Body.
+//
+// In mixed precision xd..vzd hold the authoritative position and velocity;
+// whoever writes them must refresh the float copies with syncFloat(). They
+// are empty in single precision.
+struct BodyStore {
+    AlignedVector<float> x, y, z;
+    AlignedVector<float> vx, vy, vz;
+    AlignedVector<float> ax, ay, az;
+    AlignedVector<float> mass;
+    AlignedVector<float> radius;
+    std::vector<std::uint8_t> level; // block timestep bin, step = dtMax / 2^level
+
+    AlignedVector<double> xd, yd, zd;
+    AlignedVector<double> vxd, vyd, vzd;
+
+    std::size_t size() const { return x.size(); }
+    bool empty() const { return x.empty(); }
+
+    void reserve(std::size_t n);
+    void resize(std::size_t n);
+    void clear();
+
+    // Removes every body whose keep flag is 0 in one pass, preserving the
+    // order of the survivors.
+    void compact(const std::vector<std::uint8_t>& keep);
+
+    // Switching to Mixed widens the current float state; switching back
+    // rounds it and frees the double arrays.
+    void setPrecision(Precision p);
+    Precision precision() const { return precision_; }
+    bool mixed() const { return precision_ == Precision::Mixed; }
+
+    // Widens every float position and velocity into the double arrays, for
+    // code that wrote the float state directly.
+    void syncDouble();
+
+    // Rounds the double position and velocity of body i into the float arrays.
+    void syncFloat(std::size_t i) {
+        x[i] = (float)xd[i];   y[i] = (float)yd[i];   z[i] = (float)zd[i];
+        vx[i] = (float)vxd[i]; vy[i] = (float)vyd[i]; vz[i] = (float)vzd[i];
+    }
+
+    // Defined for float and double; a double body keeps its full precision
+    // in mixed mode.
+    template <typename T>
+    void add(const BasicBody<T>& b);
+    template <typename T = float>
+    BasicBody<T> get(std::size_t i) const;
+    template <typename T>
+    void set(std::size_t i, const BasicBody<T>& b);
+
+    // non-template overloads so braced initializers keep working
+    void add(const Body& b) { add<float>(b); }
+    void set(std::size_t i, const Body& b) { set<float>(i, b); }
+
+    BodyView view() const { return { x.data(), y.data(), z.data(), radius.data(), size() }; }
+
+private:
+    Precision precision_ = Precision::Single;
+};
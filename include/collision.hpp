@@ -0,0 +1,94 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+
+// Uniform-grid broadphase. Each body is binned by the cell containing its
+// center; cells are hashed into a power-of-two table and the bodies are
+// grouped per bucket with a counting sort, so a rebuild is three linear
+// passes over flat arrays that keep their capacity between steps.
+class SpatialHash {
+public:
+    void build(const BodyStore& bodies, float cellSize, const std::vector<std::uint8_t>& inGrid);
+
+    float cellSize() const { return cellSize_; }
+
+    // Calls fn(j) for every gridded body whose cell lies in the inclusive
+    // cell range covering [lo, hi] on each axis. A body can be reported more
+    // than once if two visited cells share a bucket. When the range spans
+    // more cells than there are gridded bodies, every gridded body is
+    // reported once instead, so a huge query costs O(N) rather than
+    // O(cells); callers must do their own exact test either way.
+    template <typename Fn>
+    void query(float loX, float loY, float loZ, float hiX, float hiY, float hiZ, Fn fn) const;
+
+private:
+    std::uint32_t bucket(std::int32_t cx, std::int32_t cy, std::int32_t cz) const;
+    // clamped to +-2^30 so far-out or non-finite positions stay defined
+    std::int32_t cellCoord(float v) const;
+
+    float cellSize_ = 1.0f;
+    std::uint32_t mask_ = 0;
+    std::vector<std::uint32_t> bucketOf_;
+    std::vector<std::uint32_t> bucketStart_;
+    std::vector<std::uint32_t> sorted_;
+};
+
+// Finds overlapping spheres and merges every connected group into a single
+// body that conserves mass, momentum and center of mass, with the summed
+// volume. Merged-away bodies are removed by one in-place compaction pass.
+class CollisionResolver {
+public:
+    // Returns the number of bodies removed.
+    std::size_t resolve(BodyStore& bodies);
+
+private:
+    std::uint32_t find(std::uint32_t i);
+    void unite(std::uint32_t a, std::uint32_t b);
+
+    SpatialHash grid_;
+    std::vector<std::uint8_t> small_;    // 1 if the body lives in the grid
+    std::vector<std::uint32_t> large_;   // bodies too big for the grid cells
+    std::vector<std::uint32_t> parent_;
+    std::vector<std::uint8_t> alive_;
+
+    // per-root sums; the unweighted ones are for massless groups
+    struct GroupSum {
+        std::uint32_t count;
+        double mass, volume;
+        double mx, my, mz, mvx, mvy, mvz;
+        double x, y, z, vx, vy, vz;
+    };
+    std::vector<GroupSum> groups_;
+};
+
+template <typename Fn>
+void SpatialHash::query(float loX, float loY, float loZ, float hiX, float hiY, float hiZ, Fn fn) const {
+    if (sorted_.empty())
+        return;
+
+    const std::int32_t x0 = cellCoord(loX), x1 = cellCoord(hiX);
+    const std::int32_t y0 = cellCoord(loY), y1 = cellCoord(hiY);
+    const std::int32_t z0 = cellCoord(loZ), z1 = cellCoord(hiZ);
+
+    const std::uint64_t cells = std::uint64_t((std::int64_t)x1 - x0 + 1)
+                              * std::uint64_t((std::int64_t)y1 - y0 + 1)
+                              * std::uint64_t((std::int64_t)z1 - z0 + 1);
+    if (cells > sorted_.size()) {
+        for (std::uint32_t j : sorted_)
+            fn(j);
+        return;
+    }
+
+    for (std::int32_t cz = z0; cz <= z1; cz++) {
+        for (std::int32_t cy = y0; cy <= y1; cy++) {
+            for (std::int32_t cx = x0; cx <= x1; cx++) {
+                std::uint32_t b = bucket(cx, cy, cz);
+                for (std::uint32_t k = bucketStart_[b]; k < bucketStart_[b + 1]; k++)
+                    fn(sorted_[k]);
+            }
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+// In-place 3D complex FFT over an n^3 cube (n a power of two), stored with
+// z fastest: index = (x * n + y) * n + z. Uses FFTW when the build found it
+// (GRAVITY_SIM_HAS_FFTW), otherwise a built-in radix-2 transform that runs
+// one line per task across the pool.
+class Fft3D {
+public:
+    Fft3D() = default;
+    ~Fft3D();
+
+    Fft3D(const Fft3D&) = delete;
+    Fft3D& operator=(const Fft3D&) = delete;
+
+    // Reallocates the buffer and plans if n changed.
+    void resize(int n);
+    int size() const { return n_; }
+
+    std::complex<float>* data() { return data_; }
+    std::size_t count() const { return (std::size_t)n_ * n_ * n_; }
+
+    void forward(ThreadPool* pool = nullptr);
+    // Inverse transform including the 1 / n^3 normalization.
+    void inverse(ThreadPool* pool = nullptr);
+
+    static const char* backendName();
+
+private:
+    void transform(bool inverse, ThreadPool* pool);
+    void transformLine(std::complex<float>* line, bool inverse) const;
+    void release();
+
+    int n_ = 0;
+    std::complex<float>* data_ = nullptr;
+    std::vector<std::complex<float>> twiddles_;
+    std::vector<int> bitReverse_;
+    void* forwardPlan_ = nullptr;
+    void* inversePlan_ = nullptr;
+};
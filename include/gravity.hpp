@@ -0,0 +1,34 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+
+class ThreadPool;
+
+enum class Solver {
+    Direct,
+    BarnesHut,
+    ParticleMesh
+};
+
+const char* solverName(Solver solver);
+
+struct GravityParams {
+    float G = 1.0f;
+    float softening = 0.05f; // Plummer softening length, keeps close pairs finite
+};
+
+// Body indices whose accelerations should be refreshed; nullptr means all.
+using ActiveList = std::vector<std::uint32_t>;
+
+// Direct O(N^2) summation. Writes the softened acceleration of every active
+// body into bodies.ax/ay/az, summing over all bodies as sources. Each body
+// sums its sources in index order, so the result does not depend on how many
+// threads the pool has.
+void computeAccelerationsDirect(BodyStore& bodies, const GravityParams& params,
+                                ThreadPool* pool = nullptr,
+                                const ActiveList* active = nullptr);
+
+// Name of the instruction set the direct kernel was compiled for.
+const char* directKernelName();
@@ -0,0 +1,35 @@
+#pragma once
+#include <algorithm>
+
+enum class Integrator {
+    Leapfrog,   // kick-drift-kick, identical to velocity Verlet; 1 force pass per step
+    Yoshida4    // 4th-order composition of three leapfrog steps; 3 force passes per step
+};
+
+const char* integratorName(Integrator integrator);
+
+// Individual power-of-two timesteps. Each body sits in a bin `level` and
+// advances with dtMax / 2^level, where the bin is picked from the
+// acceleration criterion dt = eta * sqrt(softening / |a|). Only bodies that
+// finish a substep get new forces, so quiet bodies cost one force pass per
+// dtMax. Block stepping always uses leapfrog.
+struct BlockTimestepParams {
+    bool enabled = false;
+    int maxLevel = 6;      // finest step is dtMax / 2^maxLevel, clamped to MAX_LEVEL
+    float eta = 0.025f;
+
+    static constexpr int MAX_LEVEL = 20;
+    int clampedMaxLevel() const { return std::clamp(maxLevel, 0, MAX_LEVEL); }
+};
+
+// Turns variable frame times into a whole number of fixed physics steps.
+// The remainder carries over to the next frame; alpha() is how far the
+// render time sits between the last two physics states.
+struct FixedTimestep {
+    float dt = 1.0f / 240.0f;
+    int maxStepsPerFrame = 16;  // caps catch-up after a stall, dropping the rest
+    float accumulator = 0.0f;
+
+    int consume(float elapsed);
+    float alpha() const { return accumulator / dt; }
+};
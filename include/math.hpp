@@ -1,30 +1,83 @@
 #pragma once
 #include <cmath>
+#include <cstddef>
 
-struct Vec3D {
-    float x, y, z;
+template <typename T>
+struct Vec3 {
+    using Scalar = T;
+    T x, y, z;
 };
 
-struct Vec2D {
-    float x, y;
+template <typename T>
+struct Vec2 {
+    using Scalar = T;
+    T x, y;
+};
+
+using Vec3f = Vec3<float>;
+using Vec3d = Vec3<double>;
+using Vec2f = Vec2<float>;
+using Vec2d = Vec2<double>;
+
+// float is what the renderer and the force kernels use
+using Vec3D = Vec3f;
+using Vec2D = Vec2f;
+
+// The full view transform (rotate_yz by ax, rotate_xz by ay, rotate_xy by
+// az, then translate_z by dz) folded into one affine matrix, optionally with
+// the camera position subtracted first. Build it once per frame; applying it
+// costs 9 multiplies and no trig.
+struct CameraMatrix {
+    float m[3][3];
+    float t[3];
 };
 
 constexpr float NEAR_PLANE_THRESHOLD = 0.01f;
 
-Vec3D rotate_xz(const Vec3D& p, float angle);
-Vec3D rotate_yz(const Vec3D& p, float angle);
-Vec3D rotate_xy(const Vec3D& p, float angle);
-Vec3D translate_z(const Vec3D& p, float dz);
-Vec3D cross(const Vec3D& a, const Vec3D& b);
-float dot(const Vec3D& a, const Vec3D& b);
-Vec3D normalize(const Vec3D& v);
+// Generic vector math, compiled in math.cpp for float and double only.
+// T defaults to float so braced arguments like normalize({ 1, 2, 3 })
+// still resolve.
+template <typename T = float>
+Vec3<T> rotate_xz(const Vec3<T>& p, typename Vec3<T>::Scalar angle);
+template <typename T = float>
+Vec3<T> rotate_yz(const Vec3<T>& p, typename Vec3<T>::Scalar angle);
+template <typename T = float>
+Vec3<T> rotate_xy(const Vec3<T>& p, typename Vec3<T>::Scalar angle);
+template <typename T = float>
+Vec3<T> translate_z(const Vec3<T>& p, typename Vec3<T>::Scalar dz);
+template <typename T = float>
+Vec3<T> cross(const Vec3<T>& a, const Vec3<T>& b);
+template <typename T = float>
+T dot(const Vec3<T>& a, const Vec3<T>& b);
+template <typename T = float>
+Vec3<T> normalize(const Vec3<T>& v);
+
+template <typename T = float>
+Vec2<T> project(const Vec3<T>& p);
+template <typename T = float>
+Vec2<T> screen(const Vec2<T>& p, int w, int h);
+
+// Camera and projection stay single precision.
 Vec3D toViewSpace(const Vec3D& v,
                   float ax, float ay, float az,
                   float dz);
+
+CameraMatrix makeCameraMatrix(float ax, float ay, float az,
+                              float dz, const Vec3D& eye = { 0, 0, 0 });
+Vec3D toViewSpace(const CameraMatrix& cam, const Vec3D& v);
+Vec3D rotate(const CameraMatrix& cam, const Vec3D& v);
 bool clipLineToNearPlane(Vec3D& a, Vec3D& b, float nearZ);
 
-Vec2D project(const Vec3D& p);
-Vec2D screen(const Vec2D& p, int w, int h);
 Vec2D transform(const Vec3D& v,
                 float ax, float ay, float az,
                 float dz, int w, int h);
+Vec2D transform(const CameraMatrix& cam, const Vec3D& v, int w, int h);
+
+// Batch version of transform() over n points stored as separate x/y/z
+// arrays. Writes screen coordinates and view-space depth per point; points
+// at or behind the near plane get depth 0 and NaN screen coordinates.
+// Returns how many points are in front of the near plane.
+std::size_t projectToScreen(const CameraMatrix& cam,
+                            const float* x, const float* y, const float* z,
+                            std::size_t n, int w, int h,
+                            float* sx, float* sy, float* depth);
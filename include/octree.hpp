@@ -0,0 +1,66 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+#include "gravity.hpp"
+
+class ThreadPool;
+
+struct OctreeNode {
+    float minX, minY, minZ;   // bounds of the bodies below this node
+    float maxX, maxY, maxZ;
+    float size;               // longest edge of the bounds, used by the opening test
+
+    float mass;
+    float comX, comY, comZ;
+    float qxx, qxy, qxz, qyy, qyz, qzz; // traceless quadrupole about the center of mass
+
+    int firstChild;           // children are contiguous in the arena, -1 for leaves
+    int childCount;
+    int bodyStart;            // range into Octree's body order
+    int bodyCount;
+};
+
+// Barnes-Hut octree with monopole + quadrupole moments. Nodes live in a flat
+// arena that keeps its capacity between steps, so rebuilding every frame does
+// not touch the heap once the tree has reached its working size.
+class Octree {
+public:
+    static constexpr int LEAF_CAPACITY = 8;
+    static constexpr int MAX_DEPTH = 32;
+
+    // Rebuilds the topology from the current positions, then computes moments.
+    void build(const BodyStore& bodies);
+
+    // Keeps the topology and recomputes bounds and moments bottom-up. Cheaper
+    // than build() when bodies have only moved a little since the last build.
+    void refit(const BodyStore& bodies);
+
+    // Writes the tree-approximated acceleration of every active body (all of
+    // them when active is null) into ax/ay/az and returns the number of
+    // body-body and body-node interactions. Traversal order is fixed per
+    // body, so threading does not change results.
+    std::uint64_t computeAccelerations(BodyStore& bodies, const GravityParams& params,
+                                       ThreadPool* pool = nullptr,
+                                       const ActiveList* active = nullptr) const;
+
+    // Opening angle: a node of size s at distance d is used as a single
+    // multipole when s < theta * d. 0 degenerates to direct summation.
+    void setTheta(float theta) { theta_ = theta < 0.0f ? 0.0f : theta; }
+    float theta() const { return theta_; }
+
+    std::size_t nodeCount() const { return nodes_.size(); }
+    const std::vector<OctreeNode>& nodes() const { return nodes_; }
+
+private:
+    void buildNode(const BodyStore& bodies, int node,
+                   float cx, float cy, float cz, float half, int depth);
+    void computeMoments(const BodyStore& bodies);
+
+    std::vector<OctreeNode> nodes_;
+    std::vector<int> order_;
+    std::vector<int> scratch_;
+    float theta_ = 0.5f;
+};
@@ -0,0 +1,74 @@
+#pragma once
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+#include "fft.hpp"
+#include "gravity.hpp"
+
+class ThreadPool;
+
+enum class PmBoundary {
+    Periodic,   // the box tiles space; bodies wrap into it
+    Isolated    // vacuum outside the box, via zero padding to 2n
+};
+
+const char* pmBoundaryName(PmBoundary boundary);
+
+// Particle-mesh gravity. Masses are deposited onto an n^3 grid with
+// cloud-in-cell weights, the potential is found with an FFT Poisson solve,
+// differenced into a force grid and interpolated back with the same CIC
+// weights. Cost is O(N + n^3 log n), independent of clustering, with force
+// resolution limited to about two grid cells.
+//
+// Deposition sorts bodies into x slabs and processes slab pairs in two
+// alternating passes, so no two tasks ever write the same grid cell; the
+// result is deterministic for any thread count.
+class PmSolver {
+public:
+    // n must be a power of two, at least 8.
+    void setGridSize(int n);
+    int gridSize() const { return n_; }
+
+    void setBoundary(PmBoundary boundary);
+    PmBoundary boundary() const { return boundary_; }
+
+    // Periodic box [origin, origin + size)^3. If never set, the first solve
+    // fits a box around the bodies and keeps it.
+    void setPeriodicBox(const Vec3D& origin, float size);
+
+    // Writes accelerations of the active bodies (all when null); returns
+    // the number of bodies interpolated.
+    std::uint64_t computeAccelerations(BodyStore& bodies, const GravityParams& params,
+                                       ThreadPool* pool = nullptr,
+                                       const ActiveList* active = nullptr);
+
+private:
+    void fitBox(const BodyStore& bodies);
+    void deposit(const BodyStore& bodies, ThreadPool* pool);
+    void solvePeriodic(const GravityParams& params, ThreadPool* pool);
+    void solveIsolated(const GravityParams& params, ThreadPool* pool);
+    void differentiate(ThreadPool* pool);
+    void interpolate(BodyStore& bodies, const ActiveList* active, ThreadPool* pool) const;
+
+    std::size_t cell(int x, int y, int z) const { return ((std::size_t)x * n_ + y) * n_ + z; }
+
+    int n_ = 64;
+    PmBoundary boundary_ = PmBoundary::Isolated;
+
+    Vec3D origin_{ 0, 0, 0 };
+    float h_ = 1.0f;             // grid spacing
+    float boxSize_ = 0.0f;       // periodic: fixed box, isolated: current fit
+
+    std::vector<float> mass_;    // n^3 deposited mass
+    std::vector<float> phi_;     // n^3 potential
+    std::vector<float> fx_, fy_, fz_;
+
+    std::vector<std::uint32_t> order_;       // bodies sorted by x slab
+    std::vector<std::uint32_t> slabStart_;   // n + 1 offsets into order_
+
+    Fft3D fft_;
+    std::vector<std::complex<float>> green_; // transformed isolated Green's function
+    float greenH_ = 0.0f, greenEps_ = -1.0f;
+};
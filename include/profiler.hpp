@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Log-bucketed histogram over the last `window` samples (milliseconds).
+// Buckets are 1/8 octave wide starting at 1 us, so percentiles come back
+// within about 5% without sorting anything.
+class PhaseHistogram {
+public:
+    static constexpr std::size_t DEFAULT_WINDOW = 512;
+
+    explicit PhaseHistogram(std::size_t window = DEFAULT_WINDOW);
+
+    void add(double ms);
+
+    std::size_t count() const { return full_ ? window_.size() : next_; }
+    double last() const { return last_; }
+    // p in [0, 1]; 0 when empty.
+    double percentile(double p) const;
+
+private:
+    static constexpr int BUCKETS_PER_OCTAVE = 8;
+    static constexpr int BUCKETS = 1 + 24 * BUCKETS_PER_OCTAVE;
+
+    std::vector<std::uint16_t> window_;    // ring of bucket indices
+    std::size_t next_ = 0;
+    bool full_ = false;
+    std::uint32_t counts_[BUCKETS] = {};
+    double last_ = 0.0;
+};
+
+struct PhaseSummary {
+    const char* name;
+    std::size_t samples;
+    double lastMs, p50Ms, p99Ms;
+};
+
+// Process-wide sink for ProfileScope timings. Every phase keeps a rolling
+// histogram; when tracing is on, each scope is also kept as a Chrome
+// trace event ("ph": "X") until maxEvents is reached. Safe to record from
+// any thread; the scopes are coarse (a handful per frame or step), so a
+// single mutex costs nothing measurable.
+class Profiler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static Profiler& instance();
+
+    // name must outlive the profiler (a string literal).
+    void record(const char* name, Clock::time_point start, Clock::time_point end);
+
+    // Labels the calling thread in exported traces.
+    void setThreadName(const char* name);
+
+    // Phases in order of first appearance.
+    std::vector<PhaseSummary> summary() const;
+
+    void setTracing(bool enabled, std::size_t maxEvents = 1u << 20);
+    std::size_t traceEventsDropped() const;
+    // Loads in chrome://tracing or ui.perfetto.dev.
+    bool writeChromeTrace(const std::string& path) const;
+
+private:
+    Profiler();
+
+    struct Phase {
+        const char* name;
+        PhaseHistogram histogram;
+    };
+
+    struct TraceEvent {
+        const char* name;
+        std::uint32_t thread;
+        double startUs, durationUs;
+    };
+
+    mutable std::mutex mutex_;
+    Clock::time_point epoch_;
+    std::vector<Phase> phases_;
+    std::vector<TraceEvent> events_;
+    std::vector<std::pair<std::uint32_t, std::string>> threadNames_;
+    bool tracing_ = false;
+    std::size_t maxEvents_ = 0;
+    std::size_t dropped_ = 0;
+};
+
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name)
+        : name_(name), start_(Profiler::Clock::now()) {}
+    ~ProfileScope() { Profiler::instance().record(name_, start_, Profiler::Clock::now()); }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* name_;
+    Profiler::Clock::time_point start_;
+};
+
+// Times the rest of the enclosing block. Expands to nothing unless the
+// build enables GRAVITY_SIM_PROFILE.
+#ifdef GRAVITY_SIM_PROFILE
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#endif
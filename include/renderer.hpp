@@ -0,0 +1,59 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "body_store.hpp"
+#include "math.hpp"
+
+// Pre-shaded sphere sprites at a fixed ladder of diameters, packed side by
+// side into one texture. Shading only depends on the light direction in view
+// space, so the atlas is re-rendered only when that direction (quantized)
+// changes, i.e. when the light or the camera rotation moves.
+class SphereAtlas {
+public:
+    static constexpr int SIZE_COUNT = 11;
+    static constexpr int SIZES[SIZE_COUNT] = { 4, 6, 8, 12, 16, 24, 32, 48, 64, 96, 128 };
+
+    SphereAtlas();
+
+    // Re-shades the atlas if the quantized light direction differs from the
+    // one it was last shaded with. Returns true if it re-shaded.
+    bool update(const Vec3D& lightDirView);
+
+    const sf::Texture& texture() const { return texture_; }
+
+    // Left edge and diameter, in texels, of the smallest cached sprite that
+    // is at least as large as a sphere of the given on-screen radius.
+    void spriteFor(float radiusPx, float& left, float& size) const;
+
+private:
+    void shade(const Vec3D& lightDirView);
+
+    sf::Image image_;
+    sf::Texture texture_;
+    int offsets_[SIZE_COUNT];
+    std::int32_t lightKey_[3] = { INT32_MIN, INT32_MIN, INT32_MIN };
+};
+
+// Draws every visible body as a textured quad from the sphere atlas. All
+// quads go into one vertex array, sorted back to front, and are submitted
+// with a single draw call.
+class BodyRenderer {
+public:
+    void draw(sf::RenderTarget& target, const BodyView& bodies,
+              const CameraMatrix& camera, const Vec3D& lightDirView);
+
+    std::size_t visibleCount() const { return visible_.size(); }
+
+private:
+    struct Visible {
+        float depth;
+        float x, y, r;
+    };
+
+    SphereAtlas atlas_;
+    std::vector<float> sx_, sy_, depth_;
+    std::vector<Visible> visible_;
+    sf::VertexArray vertices_{ sf::PrimitiveType::Triangles };
+};
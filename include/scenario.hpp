@@ -0,0 +1,19 @@
+#pragma once
+#include <cstddef>
+
+#include "body_store.hpp"
+#include "gravity.hpp"
+
+// Initial conditions shared by the viewer and the headless driver. All of
+// them append to `bodies`.
+
+// A heavy star with a handful of planets on circular orbits.
+void makeStarSystem(BodyStore& bodies, const GravityParams& gravity);
+
+// A central mass surrounded by n light bodies on near-circular orbits in a
+// thin disk.
+void makeDisk(BodyStore& bodies, std::size_t n, unsigned seed, const GravityParams& gravity);
+
+// n equal-mass bodies sampled from a Plummer sphere of total mass 1 in
+// virial equilibrium.
+void makePlummer(BodyStore& bodies, std::size_t n, unsigned seed, const GravityParams& gravity);
@@ -0,0 +1,78 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "body_store.hpp"
+#include "integrator.hpp"
+#include "simulation.hpp"
+#include "snapshot.hpp"
+#include "triple_buffer.hpp"
+
+// What the renderer needs from one simulation state.
+struct BodySnapshot {
+    std::uint64_t step = 0;
+    double time = 0.0;
+    AlignedVector<float> x, y, z, radius;
+
+    void capture(const BodyStore& bodies, std::uint64_t atStep, double atTime);
+    BodyView view() const { return { x.data(), y.data(), z.data(), radius.data(), x.size() }; }
+};
+
+// Runs a Simulation on its own thread in real time with a fixed step and
+// publishes a snapshot after every batch of steps through a triple buffer.
+// While running, the Simulation belongs to this thread; other threads only
+// talk to it through the request* setters.
+class SimulationThread {
+public:
+    SimulationThread(Simulation& sim, float fixedDt);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Optional: snapshots are recorded from the simulation thread.
+    void setRecorder(SnapshotWriter* recorder) { recorder_ = recorder; }
+
+    void start();
+    void stop();
+
+    TripleBuffer<BodySnapshot>& snapshots() { return snapshots_; }
+
+    // Applied by the simulation thread before its next step.
+    void requestSolver(Solver solver) { solverRequest_.store((int)solver); }
+    void requestTheta(float theta) { thetaRequest_.store(theta); }
+
+private:
+    void run();
+    void publish();
+
+    Simulation& sim_;
+    FixedTimestep fixed_;
+    SnapshotWriter* recorder_ = nullptr;
+    TripleBuffer<BodySnapshot> snapshots_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{ false };
+    std::atomic<int> solverRequest_{ -1 };
+    std::atomic<float> thetaRequest_{ -1.0f };
+};
+
+// Render-side smoothing: keeps the two latest snapshots with their arrival
+// times and blends positions between them, trailing the simulation by one
+// publish interval.
+class StateInterpolator {
+public:
+    void push(const BodySnapshot& snapshot, double wallTime);
+
+    // Blended view for the given wall-clock time. Falls back to the latest
+    // state when the body count changed between the two (e.g. after merges).
+    BodyView at(double wallTime);
+
+private:
+    BodySnapshot prev_, curr_;
+    double prevTime_ = 0.0, currTime_ = 0.0;
+    bool hasPrev_ = false;
+    std::uint64_t pushes_ = 0;
+    AlignedVector<float> x_, y_, z_;
+};
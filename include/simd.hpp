@@ -0,0 +1,11 @@
+#pragma once
+
+// Picks the widest instruction set the translation unit is compiled for.
+// Kernels provide a path per macro plus a scalar fallback.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define GRAVITY_SIMD_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define GRAVITY_SIMD_SSE 1
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+#include <cstdint>
+
+#include "body_store.hpp"
+#include "collision.hpp"
+#include "gravity.hpp"
+#include "integrator.hpp"
+#include "octree.hpp"
+#include "pm_solver.hpp"
+#include "thread_pool.hpp"
+
+// Wall-clock seconds spent in each phase of the last step.
+struct StepTimings {
+    double tree = 0.0;
+    double force = 0.0;
+    double integrate = 0.0;
+    double collide = 0.0;
+};
+
+// Owns the body set, the active force solver and the worker pool, and
+// advances the system. Force evaluation and integration are both chunked
+// across the pool; results are identical for any thread count.
+class Simulation {
+public:
+    // threads == 0 uses every hardware thread.
+    explicit Simulation(unsigned threads = 0);
+
+    BodyStore& bodies() { return bodies_; }
+    const BodyStore& bodies() const { return bodies_; }
+
+    GravityParams& gravity() { return gravity_; }
+    Octree& tree() { return tree_; }
+    PmSolver& pm() { return pm_; }
+    ThreadPool& pool() { return pool_; }
+
+    Solver solver() const { return solver_; }
+    void setSolver(Solver solver) { solver_ = solver; }
+
+    Integrator integrator() const { return integrator_; }
+    void setIntegrator(Integrator integrator) { integrator_ = integrator; }
+
+    BlockTimestepParams& blockTimesteps() { return blocks_; }
+
+    Precision precision() const { return bodies_.precision(); }
+    void setPrecision(Precision precision) { bodies_.setPrecision(precision); }
+
+    // When enabled, overlapping bodies are merged at the end of every step.
+    bool collisions() const { return collisions_; }
+    void setCollisions(bool enabled) { collisions_ = enabled; }
+
+    // Fills ax/ay/az of the active bodies (all when null) with the active
+    // solver. Rebuilds the tree unless refit is set.
+    void computeForces(const ActiveList* active = nullptr, bool refit = false);
+
+    // Call after adding, removing or teleporting bodies so the next step
+    // recomputes accelerations instead of reusing the cached ones.
+    void invalidateForces() { forcesValid_ = false; }
+
+    // Advances by dt: one leapfrog or Yoshida step, or, with block timesteps
+    // enabled, one block step in which dt is the largest individual step.
+    void step(float dt);
+
+    double time() const { return time_; }
+    std::uint64_t stepCount() const { return stepCount_; }
+
+    const StepTimings& lastTimings() const { return timings_; }
+    // Pairwise (or body-node) force evaluations done by the last step.
+    std::uint64_t lastInteractions() const { return interactions_; }
+    // Number of per-body accelerations computed by the last step.
+    std::uint64_t lastForceEvaluations() const { return forceEvaluations_; }
+    // Bodies removed by merging during the last step.
+    std::size_t lastMerges() const { return merges_; }
+
+    double kineticEnergy();
+    double potentialEnergy();
+
+private:
+    void kick(float dt);
+    // kicks each listed body by dtMax / 2^level, i.e. scaled to its own step
+    void kickBlock(float dtMax, const ActiveList& active);
+    void drift(float dt);
+    void stepLeapfrog(float dt);
+    void stepYoshida(float dt);
+    void stepBlock(float dtMax);
+    int levelFor(std::size_t i, float dtMax) const;
+
+    BodyStore bodies_;
+    GravityParams gravity_;
+    Solver solver_ = Solver::BarnesHut;
+    Integrator integrator_ = Integrator::Leapfrog;
+    BlockTimestepParams blocks_;
+    Octree tree_;
+    PmSolver pm_;
+    CollisionResolver collider_;
+    bool collisions_ = false;
+    ThreadPool pool_;
+    ActiveList active_;
+    bool forcesValid_ = false;
+    double time_ = 0.0;
+    std::uint64_t stepCount_ = 0;
+    StepTimings timings_;
+    std::uint64_t interactions_ = 0;
+    std::uint64_t forceEvaluations_ = 0;
+    std::size_t merges_ = 0;
+};
@@ -0,0 +1,139 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "body_store.hpp"
+#include "mapped_file.hpp"
+
+// Snapshot file layout (native little-endian):
+//
+//   SnapshotFileHeader
+//   frame chunk 0 .. frame chunk N-1
+//   uint64 offsets[N]        frame index, absolute file offsets
+//   SnapshotFooter
+//
+// A frame chunk is a SnapshotFrameHeader followed by positions (three
+// float arrays, or three uint16 arrays padded to 8 bytes in quantized mode)
+// and then vx, vy, vz, mass, radius as float arrays. Chunks are padded to a
+// multiple of 8 bytes. A file whose writer died before the index was written
+// can still be read; the reader rebuilds the index by walking the chunks.
+
+enum class PositionEncoding : std::uint32_t {
+    Float32 = 0,
+    Quantized16 = 1   // per-frame, per-axis 16-bit fixed point over the bounding box
+};
+
+struct SnapshotFileHeader {
+    char magic[8];            // "GRAVSNAP"
+    std::uint32_t version;
+    std::uint32_t encoding;   // PositionEncoding
+    std::uint64_t reserved;
+};
+
+struct SnapshotFrameHeader {
+    std::uint32_t tag;        // SNAPSHOT_FRAME_TAG
+    std::uint32_t bodyCount;
+    std::uint64_t step;
+    double time;
+    float posOrigin[3];       // quantized mode: value of code 0
+    float posStep[3];         // quantized mode: size of one code
+    std::uint64_t byteSize;   // whole chunk including this header
+};
+
+struct SnapshotFooter {
+    std::uint64_t indexOffset;
+    std::uint64_t frameCount;
+    char magic[8];            // "GRAVINDX"
+};
+
+constexpr std::uint32_t SNAPSHOT_VERSION = 1;
+constexpr std::uint32_t SNAPSHOT_FRAME_TAG = 0x454d5246; // "FRME"
+
+struct SnapshotFrameInfo {
+    std::uint64_t step;
+    double time;
+};
+
+// Streams frames to disk from a background thread. submit() copies the body
+// state into the free half of a double buffer and returns; encoding and
+// file I/O happen on the writer thread. If the writer is still busy with the
+// previous frame the new one is dropped rather than blocking the caller.
+class SnapshotWriter {
+public:
+    SnapshotWriter() = default;
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    bool open(const std::string& path, PositionEncoding encoding = PositionEncoding::Float32);
+
+    // Returns false if the frame was dropped or the writer has failed.
+    bool submit(const BodyStore& bodies, std::uint64_t step, double time);
+
+    // Waits for the pending frame, then writes the index and footer.
+    // Returns false if any write failed; the file then holds the frames
+    // written before the failure.
+    bool close();
+
+    bool isOpen() const { return file_ != nullptr; }
+    // Set by the first short write; no further frames are accepted.
+    bool failed() const;
+    std::uint64_t framesWritten() const;
+    std::uint64_t framesDropped() const;
+
+private:
+    struct Frame {
+        std::uint64_t step = 0;
+        double time = 0.0;
+        std::vector<float> x, y, z, vx, vy, vz, mass, radius;
+    };
+
+    void writerLoop();
+    void writeFrame(const Frame& frame);
+
+    std::FILE* file_ = nullptr;
+    PositionEncoding encoding_ = PositionEncoding::Float32;
+    std::uint64_t offset_ = 0;
+    std::vector<std::uint64_t> index_;
+    std::vector<unsigned char> chunk_;
+
+    Frame front_;   // owned by the writer thread while it encodes
+    Frame back_;    // filled by submit()
+    bool backFull_ = false;
+    bool stop_ = false;
+    bool failed_ = false;
+    std::uint64_t dropped_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::thread thread_;
+};
+
+// Memory-maps a snapshot file and decodes any frame in O(1) through the
+// frame index.
+class SnapshotReader {
+public:
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return file_.isOpen(); }
+    std::size_t frameCount() const { return offsets_.size(); }
+    PositionEncoding encoding() const { return encoding_; }
+
+    // Decodes frame k into bodies, resizing it to the frame's body count.
+    bool readFrame(std::size_t k, BodyStore& bodies, SnapshotFrameInfo* info = nullptr) const;
+
+private:
+    bool readIndex();
+    void scanFrames();
+
+    MappedFile file_;
+    PositionEncoding encoding_ = PositionEncoding::Float32;
+    std::vector<std::uint64_t> offsets_;
+};
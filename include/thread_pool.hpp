@@ -0,0 +1,89 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent work-stealing pool. Workers are created once and sleep between
+// jobs. A parallel loop is cut into fixed-size chunks that are dealt out to
+// per-worker deques; idle workers steal from the back of other deques. The
+// calling thread takes part in the work, so a pool of N threads starts N-1
+// workers.
+//
+// Chunk boundaries depend only on the range and the grain, never on the
+// thread count, so anything computed per chunk (and reduced in chunk order)
+// is bit-for-bit identical no matter how many threads run it.
+//
+// parallelFor/parallelReduce must not be called from inside a task, and only
+// one thread may submit work at a time.
+class ThreadPool {
+public:
+    using RangeFn = std::function<void(std::size_t begin, std::size_t end)>;
+
+    // threads == 0 picks std::thread::hardware_concurrency().
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned threadCount() const { return (unsigned)workers_.size() + 1; }
+
+    // Calls fn(begin, end) for consecutive chunks of at most `grain` items
+    // covering [0, n). Returns once every chunk has run.
+    void parallelFor(std::size_t n, std::size_t grain, const RangeFn& fn);
+
+    // Maps every chunk to a partial result, then folds the partials in chunk
+    // order. Deterministic for non-associative types such as float.
+    template <typename T, typename Map, typename Combine>
+    T parallelReduce(std::size_t n, std::size_t grain, T init, Map map, Combine combine) {
+        if (grain == 0)
+            grain = 1;
+        const std::size_t chunks = (n + grain - 1) / grain;
+        std::vector<T> partial(chunks, init);
+        parallelFor(n, grain, [&](std::size_t begin, std::size_t end) {
+            partial[begin / grain] = map(begin, end);
+        });
+
+        T result = init;
+        for (const T& p : partial)
+            result = combine(result, p);
+        return result;
+    }
+
+private:
+    struct Job {
+        const RangeFn* fn;
+        std::atomic<std::size_t> remaining;
+    };
+
+    struct Task {
+        Job* job;
+        std::size_t begin, end;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void workerLoop(std::size_t index);
+    bool tryPop(std::size_t index, Task& out);
+    bool trySteal(std::size_t index, Task& out);
+    void run(const Task& task);
+
+    // slot 0 belongs to the submitting thread, slot i + 1 to workers_[i]
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::atomic<std::size_t> pending_{ 0 };
+    bool stop_ = false;
+};
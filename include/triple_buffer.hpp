@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// Lock-free single-producer / single-consumer triple buffer. The producer
+// always owns one slot, the consumer another, and the third sits in the
+// middle holding the most recently published value. publish() and update()
+// are a single atomic exchange each, so neither side ever waits for the
+// other; the consumer simply skips values it was too slow to see.
+template <typename T>
+class TripleBuffer {
+public:
+    // Producer side: fill writeBuffer(), then publish() it.
+    T& writeBuffer() { return buffers_[write_]; }
+
+    void publish() {
+        std::uint8_t prev = middle_.exchange(std::uint8_t(write_ | FRESH), std::memory_order_acq_rel);
+        write_ = prev & INDEX_MASK;
+    }
+
+    // Consumer side: update() swaps in the latest published value if there
+    // is one and returns whether it did; readBuffer() stays valid until the
+    // next update().
+    bool update() {
+        if (!(middle_.load(std::memory_order_acquire) & FRESH))
+            return false;
+        std::uint8_t prev = middle_.exchange(read_, std::memory_order_acq_rel);
+        read_ = prev & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return buffers_[read_]; }
+
+private:
+    static constexpr std::uint8_t INDEX_MASK = 0x3;
+    static constexpr std::uint8_t FRESH = 0x4;
+
+    T buffers_[3];
+    std::uint8_t write_ = 0;
+    std::uint8_t read_ = 1;
+    std::atomic<std::uint8_t> middle_{ 2 };
+};
@@ -0,0 +1,159 @@
+#include "body_store.hpp"
+
+const char* precisionName(Precision precision) {
+    switch (precision) {
+    case Precision::Single: return "single";
+    case Precision::Mixed:  return "mixed";
+    }
+    return "unknown";
+}
+
+void BodyStore::reserve(std::size_t n) {
+    x.reserve(n);  y.reserve(n);  z.reserve(n);
+    vx.reserve(n); vy.reserve(n); vz.reserve(n);
+    ax.reserve(n); ay.reserve(n); az.reserve(n);
+    mass.reserve(n);
+    radius.reserve(n);
+    level.reserve(n);
+    if (mixed()) {
+        xd.reserve(n);  yd.reserve(n);  zd.reserve(n);
+        vxd.reserve(n); vyd.reserve(n); vzd.reserve(n);
+    }
+}
+
+void BodyStore::resize(std::size_t n) {
+    x.resize(n);  y.resize(n);  z.resize(n);
+    vx.resize(n); vy.resize(n); vz.resize(n);
+    ax.resize(n); ay.resize(n); az.resize(n);
+    mass.resize(n);
+    radius.resize(n);
+    level.resize(n);
+    if (mixed()) {
+        xd.resize(n);  yd.resize(n);  zd.resize(n);
+        vxd.resize(n); vyd.resize(n); vzd.resize(n);
+    }
+}
+
+void BodyStore::clear() {
+    resize(0);
+}
+
+void BodyStore::compact(const std::vector<std::uint8_t>& keep) {
+    const std::size_t n = size();
+    const bool wide = mixed();
+    std::size_t w = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        if (!keep[i])
+            continue;
+        if (w != i) {
+            x[w] = x[i];   y[w] = y[i];   z[w] = z[i];
+            vx[w] = vx[i]; vy[w] = vy[i]; vz[w] = vz[i];
+            ax[w] = ax[i]; ay[w] = ay[i]; az[w] = az[i];
+            mass[w] = mass[i];
+            radius[w] = radius[i];
+            level[w] = level[i];
+            if (wide) {
+                xd[w] = xd[i];   yd[w] = yd[i];   zd[w] = zd[i];
+                vxd[w] = vxd[i]; vyd[w] = vyd[i]; vzd[w] = vzd[i];
+            }
+        }
+        w++;
+    }
+    resize(w);
+}
+
+void BodyStore::setPrecision(Precision p) {
+    if (p == precision_)
+        return;
+    precision_ = p;
+
+    if (p == Precision::Mixed) {
+        syncDouble();
+    } else {
+        // the float arrays are already the rounded state
+        AlignedVector<double>().swap(xd);
+        AlignedVector<double>().swap(yd);
+        AlignedVector<double>().swap(zd);
+        AlignedVector<double>().swap(vxd);
+        AlignedVector<double>().swap(vyd);
+        AlignedVector<double>().swap(vzd);
+    }
+}
+
+void BodyStore::syncDouble() {
+    xd.assign(x.begin(), x.end());
+    yd.assign(y.begin(), y.end());
+    zd.assign(z.begin(), z.end());
+    vxd.assign(vx.begin(), vx.end());
+    vyd.assign(vy.begin(), vy.end());
+    vzd.assign(vz.begin(), vz.end());
+}
+
+template <typename T>
+void BodyStore::add(const BasicBody<T>& b) {
+    x.push_back((float)b.position.x);
+    y.push_back((float)b.position.y);
+    z.push_back((float)b.position.z);
+    vx.push_back((float)b.velocity.x);
+    vy.push_back((float)b.velocity.y);
+    vz.push_back((float)b.velocity.z);
+    ax.push_back(0.0f);
+    ay.push_back(0.0f);
+    az.push_back(0.0f);
+    mass.push_back((float)b.mass);
+    radius.push_back((float)b.radius);
+    level.push_back(0);
+    if (mixed()) {
+        xd.push_back(b.position.x);
+        yd.push_back(b.position.y);
+        zd.push_back(b.position.z);
+        vxd.push_back(b.velocity.x);
+        vyd.push_back(b.velocity.y);
+        vzd.push_back(b.velocity.z);
+    }
+}
+
+template <typename T>
+BasicBody<T> BodyStore::get(std::size_t i) const {
+    if (mixed()) {
+        return BasicBody<T>{
+            { (T)xd[i], (T)yd[i], (T)zd[i] },
+            { (T)vxd[i], (T)vyd[i], (T)vzd[i] },
+            mass[i],
+            radius[i]
+        };
+    }
+    return BasicBody<T>{
+        { x[i], y[i], z[i] },
+        { vx[i], vy[i], vz[i] },
+        mass[i],
+        radius[i]
+    };
+}
+
+template <typename T>
+void BodyStore::set(std::size_t i, const BasicBody<T>& b) {
+    x[i] = (float)b.position.x;
+    y[i] = (float)b.position.y;
+    z[i] = (float)b.position.z;
+    vx[i] = (float)b.velocity.x;
+    vy[i] = (float)b.velocity.y;
+    vz[i] = (float)b.velocity.z;
+    mass[i] = (float)b.mass;
+    radius[i] = (float)b.radius;
+    if (mixed()) {
+        xd[i] = b.position.x;
+        yd[i] = b.position.y;
+        zd[i] = b.position.z;
+        vxd[i] = b.velocity.x;
+        vyd[i] = b.velocity.y;
+        vzd[i] = b.velocity.z;
+    }
+}
+
+template void BodyStore::add<float>(const BasicBody<float>&);
+template void BodyStore::add<double>(const BasicBody<double>&);
+template BasicBody<float> BodyStore::get<float>(std::size_t) const;
+template BasicBody<double> BodyStore::get<double>(std::size_t) const;
+template void BodyStore::set<float>(std::size_t, const BasicBody<float>&);
+template void BodyStore::set<double>(std::size_t, const BasicBody<double>&);
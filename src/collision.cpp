@@ -0,0 +1,228 @@
+#include "collision.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Bodies up to this multiple of the mean radius go into the grid; larger
+// ones are few and query the grid over their own extent instead.
+constexpr float SMALL_RADIUS_FACTOR = 2.0f;
+
+// cell coordinates are clamped to this so the casts and the per-axis cell
+// counts in query() cannot overflow
+constexpr float CELL_LIMIT = 1073741824.0f;  // 2^30
+
+bool overlaps(const BodyStore& b, std::uint32_t i, std::uint32_t j) {
+    float dx = b.x[j] - b.x[i];
+    float dy = b.y[j] - b.y[i];
+    float dz = b.z[j] - b.z[i];
+    float r = b.radius[i] + b.radius[j];
+    return dx*dx + dy*dy + dz*dz < r * r;
+}
+
+} // namespace
+
+std::int32_t SpatialHash::cellCoord(float v) const {
+    const float c = std::floor(v / cellSize_);
+    if (c < CELL_LIMIT && c > -CELL_LIMIT)
+        return (std::int32_t)c;
+    return c > 0.0f ? (std::int32_t)CELL_LIMIT : -(std::int32_t)CELL_LIMIT;
+}
+
+std::uint32_t SpatialHash::bucket(std::int32_t cx, std::int32_t cy, std::int32_t cz) const {
+    std::uint32_t h = (std::uint32_t)cx * 73856093u
+                    ^ (std::uint32_t)cy * 19349663u
+                    ^ (std::uint32_t)cz * 83492791u;
+    return h & mask_;
+}
+
+void SpatialHash::build(const BodyStore& bodies, float cellSize, const std::vector<std::uint8_t>& inGrid) {
+    const std::size_t n = bodies.size();
+    cellSize_ = cellSize > 0.0f ? cellSize : 1.0f;
+
+    std::uint32_t tableSize = 1;
+    while (tableSize < 2 * n)
+        tableSize <<= 1;
+    mask_ = tableSize - 1;
+
+    bucketOf_.resize(n);
+    bucketStart_.assign(tableSize + 1, 0);
+
+    std::size_t gridded = 0;
+    for (std::size_t i = 0; i < n; i++) {
+        if (!inGrid[i])
+            continue;
+        std::uint32_t b = bucket(cellCoord(bodies.x[i]), cellCoord(bodies.y[i]), cellCoord(bodies.z[i]));
+        bucketOf_[i] = b;
+        bucketStart_[b + 1]++;
+        gridded++;
+    }
+
+    for (std::uint32_t b = 0; b < tableSize; b++)
+        bucketStart_[b + 1] += bucketStart_[b];
+
+    // scatter, using bucketOf_ as the write cursor source
+    sorted_.resize(gridded);
+    for (std::size_t i = 0; i < n; i++) {
+        if (!inGrid[i])
+            continue;
+        sorted_[bucketStart_[bucketOf_[i]]++] = (std::uint32_t)i;
+    }
+
+    // the scatter advanced every start to its end; shift back by one bucket
+    for (std::uint32_t b = tableSize; b > 0; b--)
+        bucketStart_[b] = bucketStart_[b - 1];
+    bucketStart_[0] = 0;
+}
+
+std::uint32_t CollisionResolver::find(std::uint32_t i) {
+    while (parent_[i] != i) {
+        parent_[i] = parent_[parent_[i]];
+        i = parent_[i];
+    }
+    return i;
+}
+
+void CollisionResolver::unite(std::uint32_t a, std::uint32_t b) {
+    a = find(a);
+    b = find(b);
+    if (a == b)
+        return;
+    // the lowest index survives, so merged bodies keep their place in order
+    if (a < b)
+        parent_[b] = a;
+    else
+        parent_[a] = b;
+}
+
+std::size_t CollisionResolver::resolve(BodyStore& bodies) {
+    const std::size_t n = bodies.size();
+    if (n < 2)
+        return 0;
+
+    float meanRadius = 0.0f;
+    for (std::size_t i = 0; i < n; i++)
+        meanRadius += bodies.radius[i];
+    meanRadius /= n;
+    if (meanRadius <= 0.0f)
+        return 0;
+
+    const float smallLimit = SMALL_RADIUS_FACTOR * meanRadius;
+
+    small_.resize(n);
+    large_.clear();
+    float maxSmall = 0.0f;
+    for (std::size_t i = 0; i < n; i++) {
+        bool isSmall = bodies.radius[i] <= smallLimit;
+        small_[i] = isSmall;
+        if (isSmall)
+            maxSmall = std::max(maxSmall, bodies.radius[i]);
+        else
+            large_.push_back((std::uint32_t)i);
+    }
+
+    // with cells two max-radii wide, overlapping small bodies are always in
+    // the same or adjacent cells
+    grid_.build(bodies, 2.0f * std::max(maxSmall, 1e-6f), small_);
+
+    parent_.resize(n);
+    for (std::size_t i = 0; i < n; i++)
+        parent_[i] = (std::uint32_t)i;
+
+    bool merged = false;
+    auto test = [&](std::uint32_t i, std::uint32_t j) {
+        if (i != j && overlaps(bodies, i, j)) {
+            unite(i, j);
+            merged = true;
+        }
+    };
+
+    for (std::size_t ii = 0; ii < n; ii++) {
+        if (!small_[ii])
+            continue;
+        const std::uint32_t i = (std::uint32_t)ii;
+        const float reach = bodies.radius[i] + maxSmall;
+        grid_.query(bodies.x[i] - reach, bodies.y[i] - reach, bodies.z[i] - reach,
+                    bodies.x[i] + reach, bodies.y[i] + reach, bodies.z[i] + reach,
+                    [&](std::uint32_t j) { if (j > i) test(i, j); });
+    }
+
+    for (std::size_t a = 0; a < large_.size(); a++) {
+        const std::uint32_t i = large_[a];
+        const float reach = bodies.radius[i] + maxSmall;
+        grid_.query(bodies.x[i] - reach, bodies.y[i] - reach, bodies.z[i] - reach,
+                    bodies.x[i] + reach, bodies.y[i] + reach, bodies.z[i] + reach,
+                    [&](std::uint32_t j) { test(i, j); });
+        for (std::size_t b = a + 1; b < large_.size(); b++)
+            test(i, large_[b]);
+    }
+
+    if (!merged)
+        return 0;
+
+    // sum every group into its root in double, then write each root once;
+    // roots have the lowest index of their group, so they are visited
+    // before any of their members
+    const bool mixed = bodies.mixed();
+    groups_.resize(n);
+    alive_.assign(n, 1);
+    for (std::size_t i = 0; i < n; i++) {
+        const std::uint32_t r = find((std::uint32_t)i);
+        GroupSum& g = groups_[r];
+        if (r == i)
+            g = GroupSum{};
+        else
+            alive_[i] = 0;
+
+        const double m = bodies.mass[i];
+        const double x = mixed ? bodies.xd[i] : bodies.x[i];
+        const double y = mixed ? bodies.yd[i] : bodies.y[i];
+        const double z = mixed ? bodies.zd[i] : bodies.z[i];
+        const double vx = mixed ? bodies.vxd[i] : bodies.vx[i];
+        const double vy = mixed ? bodies.vyd[i] : bodies.vy[i];
+        const double vz = mixed ? bodies.vzd[i] : bodies.vz[i];
+        const double radius = bodies.radius[i];
+
+        g.count++;
+        g.mass += m;
+        g.mx += m * x;   g.my += m * y;   g.mz += m * z;
+        g.mvx += m * vx; g.mvy += m * vy; g.mvz += m * vz;
+        g.x += x;        g.y += y;        g.z += z;
+        g.vx += vx;      g.vy += vy;      g.vz += vz;
+        g.volume += radius * radius * radius;
+    }
+
+    for (std::size_t r = 0; r < n; r++) {
+        const GroupSum& g = groups_[r];
+        if (!alive_[r] || g.count < 2)
+            continue;
+
+        // massless groups fall back to the plain mean
+        double x, y, z, vx, vy, vz;
+        if (g.mass > 0.0) {
+            const double inv = 1.0 / g.mass;
+            x = g.mx * inv;   y = g.my * inv;   z = g.mz * inv;
+            vx = g.mvx * inv; vy = g.mvy * inv; vz = g.mvz * inv;
+        } else {
+            const double inv = 1.0 / g.count;
+            x = g.x * inv;    y = g.y * inv;    z = g.z * inv;
+            vx = g.vx * inv;  vy = g.vy * inv;  vz = g.vz * inv;
+        }
+
+        if (mixed) {
+            bodies.xd[r] = x;   bodies.yd[r] = y;   bodies.zd[r] = z;
+            bodies.vxd[r] = vx; bodies.vyd[r] = vy; bodies.vzd[r] = vz;
+            bodies.syncFloat(r);
+        } else {
+            bodies.x[r] = (float)x;   bodies.y[r] = (float)y;   bodies.z[r] = (float)z;
+            bodies.vx[r] = (float)vx; bodies.vy[r] = (float)vy; bodies.vz[r] = (float)vz;
+        }
+        bodies.mass[r] = (float)g.mass;
+        bodies.radius[r] = (float)std::cbrt(g.volume);
+    }
+
+    const std::size_t before = n;
+    bodies.compact(alive_);
+    return before - bodies.size();
+}
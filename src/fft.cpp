@@ -0,0 +1,175 @@
+#include "fft.hpp"
+#include "thread_pool.hpp"
+
+#include <cmath>
+#include <new>
+#include <utility>
+
+#ifdef GRAVITY_SIM_HAS_FFTW
+#include <fftw3.h>
+#endif
+
+namespace {
+
+constexpr double PI = 3.14159265358979323846;
+
+} // namespace
+
+Fft3D::~Fft3D() {
+    release();
+}
+
+void Fft3D::release() {
+#ifdef GRAVITY_SIM_HAS_FFTW
+    if (forwardPlan_)
+        fftwf_destroy_plan((fftwf_plan)forwardPlan_);
+    if (inversePlan_)
+        fftwf_destroy_plan((fftwf_plan)inversePlan_);
+    if (data_)
+        fftwf_free(data_);
+#else
+    if (data_)
+        ::operator delete(data_, std::align_val_t(64));
+#endif
+    forwardPlan_ = inversePlan_ = nullptr;
+    data_ = nullptr;
+    n_ = 0;
+}
+
+void Fft3D::resize(int n) {
+    if (n == n_)
+        return;
+    release();
+    if (n <= 0)
+        return;
+
+    n_ = n;
+    const std::size_t total = count();
+
+#ifdef GRAVITY_SIM_HAS_FFTW
+    data_ = reinterpret_cast<std::complex<float>*>(fftwf_alloc_complex(total));
+    auto* buf = reinterpret_cast<fftwf_complex*>(data_);
+    forwardPlan_ = fftwf_plan_dft_3d(n, n, n, buf, buf, FFTW_FORWARD, FFTW_ESTIMATE);
+    inversePlan_ = fftwf_plan_dft_3d(n, n, n, buf, buf, FFTW_BACKWARD, FFTW_ESTIMATE);
+#else
+    data_ = static_cast<std::complex<float>*>(
+        ::operator new(total * sizeof(std::complex<float>), std::align_val_t(64)));
+#endif
+
+    for (std::size_t i = 0; i < total; i++)
+        data_[i] = 0.0f;
+
+    int bits = 0;
+    while ((1 << bits) < n)
+        bits++;
+
+    bitReverse_.resize(n);
+    for (int i = 0; i < n; i++) {
+        int r = 0;
+        for (int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1) << (bits - 1 - b);
+        bitReverse_[i] = r;
+    }
+
+    twiddles_.resize(n / 2);
+    for (int k = 0; k < n / 2; k++) {
+        double a = -2.0 * PI * k / n;
+        twiddles_[k] = { (float)std::cos(a), (float)std::sin(a) };
+    }
+}
+
+void Fft3D::forward(ThreadPool* pool) {
+    transform(false, pool);
+}
+
+void Fft3D::inverse(ThreadPool* pool) {
+    transform(true, pool);
+
+    const float scale = 1.0f / (float)count();
+    const std::size_t total = count();
+    auto normalize = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t i = begin; i < end; i++)
+            data_[i] *= scale;
+    };
+    if (pool)
+        pool->parallelFor(total, 1 << 16, normalize);
+    else
+        normalize(0, total);
+}
+
+const char* Fft3D::backendName() {
+#ifdef GRAVITY_SIM_HAS_FFTW
+    return "fftw";
+#else
+    return "radix-2";
+#endif
+}
+
+void Fft3D::transformLine(std::complex<float>* line, bool inverse) const {
+    const int n = n_;
+    for (int i = 0; i < n; i++) {
+        int r = bitReverse_[i];
+        if (i < r)
+            std::swap(line[i], line[r]);
+    }
+
+    for (int len = 2; len <= n; len <<= 1) {
+        const int half = len >> 1;
+        const int stride = n / len;
+        for (int start = 0; start < n; start += len) {
+            for (int k = 0; k < half; k++) {
+                std::complex<float> w = twiddles_[k * stride];
+                if (inverse)
+                    w = std::conj(w);
+                std::complex<float> a = line[start + k];
+                std::complex<float> b = line[start + k + half] * w;
+                line[start + k] = a + b;
+                line[start + k + half] = a - b;
+            }
+        }
+    }
+}
+
+void Fft3D::transform(bool inverse, ThreadPool* pool) {
+    if (n_ == 0)
+        return;
+
+#ifdef GRAVITY_SIM_HAS_FFTW
+    (void)pool;
+    fftwf_execute((fftwf_plan)(inverse ? inversePlan_ : forwardPlan_));
+#else
+    const std::size_t n = n_;
+    const std::size_t lines = n * n;
+
+    // axis 0 is z (contiguous), 1 is y, 2 is x
+    for (int axis = 0; axis < 3; axis++) {
+        const std::size_t stride = axis == 0 ? 1 : axis == 1 ? n : n * n;
+
+        auto run = [&](std::size_t begin, std::size_t end) {
+            std::vector<std::complex<float>> line(n);
+            for (std::size_t l = begin; l < end; l++) {
+                // l enumerates the two axes other than `axis`
+                std::size_t a = l / n, b = l % n;
+                std::size_t base = axis == 0 ? (a * n + b) * n
+                                 : axis == 1 ? a * n * n + b
+                                 :             a * n + b;
+
+                if (stride == 1) {
+                    transformLine(data_ + base, inverse);
+                    continue;
+                }
+                for (std::size_t i = 0; i < n; i++)
+                    line[i] = data_[base + i * stride];
+                transformLine(line.data(), inverse);
+                for (std::size_t i = 0; i < n; i++)
+                    data_[base + i * stride] = line[i];
+            }
+        };
+
+        if (pool)
+            pool->parallelFor(lines, 16, run);
+        else
+            run(0, lines);
+    }
+#endif
+}
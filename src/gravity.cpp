@@ -0,0 +1,268 @@
+#include "gravity.hpp"
+#include "simd.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+namespace {
+
+// bodies per float partial sum
+constexpr std::size_t ACCUMULATE_TILE = 1024;
+
+struct Accel {
+    float x, y, z;
+};
+
+// Every path takes the target position in double. With Wide set the pair
+// separations are formed from the double positions (xd..zd) and only then
+// narrowed to float, so close pairs far from the origin keep their
+// separation; otherwise everything runs on the float copies.
+
+// Scalar tail shared by every path: sums bodies [begin, end) acting on (px, py, pz).
+template <bool Wide>
+Accel accumulateScalar(const BodyStore& b, std::size_t begin, std::size_t end,
+                       double px, double py, double pz, float eps2)
+{
+    Accel a{ 0.0f, 0.0f, 0.0f };
+    for (std::size_t j = begin; j < end; j++) {
+        float dx, dy, dz;
+        if constexpr (Wide) {
+            dx = (float)(b.xd[j] - px);
+            dy = (float)(b.yd[j] - py);
+            dz = (float)(b.zd[j] - pz);
+        } else {
+            dx = b.x[j] - (float)px;
+            dy = b.y[j] - (float)py;
+            dz = b.z[j] - (float)pz;
+        }
+        float r2 = dx*dx + dy*dy + dz*dz + eps2;
+        if (r2 <= 0.0f)
+            continue;
+
+        float inv = 1.0f / std::sqrt(r2);
+        float s = b.mass[j] * inv * inv * inv;
+        a.x += dx * s;
+        a.y += dy * s;
+        a.z += dz * s;
+    }
+    return a;
+}
+
+#if defined(GRAVITY_SIMD_AVX2)
+
+float hsum(__m256 v) {
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, v);
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3]))
+         + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+// x[j .. j + 8) - p computed in double, narrowed to float
+__m256 separation(const double* x, __m256d p) {
+    __m128 lo = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_load_pd(x), p));
+    __m128 hi = _mm256_cvtpd_ps(_mm256_sub_pd(_mm256_load_pd(x + 4), p));
+    return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+template <bool Wide>
+Accel accumulate(const BodyStore& b, std::size_t begin, std::size_t end,
+                 double px, double py, double pz, float eps2)
+{
+    const std::size_t nv = begin + ((end - begin) & ~std::size_t(7));
+
+    const __m256 vpx = _mm256_set1_ps((float)px);
+    const __m256 vpy = _mm256_set1_ps((float)py);
+    const __m256 vpz = _mm256_set1_ps((float)pz);
+    const __m256d wpx = _mm256_set1_pd(px);
+    const __m256d wpy = _mm256_set1_pd(py);
+    const __m256d wpz = _mm256_set1_pd(pz);
+    const __m256 veps2 = _mm256_set1_ps(eps2);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 sx = zero, sy = zero, sz = zero;
+    for (std::size_t j = begin; j < nv; j += 8) {
+        __m256 dx, dy, dz;
+        if constexpr (Wide) {
+            dx = separation(&b.xd[j], wpx);
+            dy = separation(&b.yd[j], wpy);
+            dz = separation(&b.zd[j], wpz);
+        } else {
+            dx = _mm256_sub_ps(_mm256_load_ps(&b.x[j]), vpx);
+            dy = _mm256_sub_ps(_mm256_load_ps(&b.y[j]), vpy);
+            dz = _mm256_sub_ps(_mm256_load_ps(&b.z[j]), vpz);
+        }
+
+        __m256 r2 = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+            _mm256_add_ps(_mm256_mul_ps(dz, dz), veps2));
+
+        // r2 == 0 only for the self pair when softening is zero; mask it out
+        __m256 valid = _mm256_cmp_ps(r2, zero, _CMP_GT_OQ);
+        __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(r2));
+        __m256 s = _mm256_mul_ps(_mm256_load_ps(&b.mass[j]),
+                                 _mm256_mul_ps(inv, _mm256_mul_ps(inv, inv)));
+        s = _mm256_and_ps(s, valid);
+
+        sx = _mm256_add_ps(sx, _mm256_mul_ps(dx, s));
+        sy = _mm256_add_ps(sy, _mm256_mul_ps(dy, s));
+        sz = _mm256_add_ps(sz, _mm256_mul_ps(dz, s));
+    }
+
+    Accel tail = accumulateScalar<Wide>(b, nv, end, px, py, pz, eps2);
+    return { hsum(sx) + tail.x, hsum(sy) + tail.y, hsum(sz) + tail.z };
+}
+
+#elif defined(GRAVITY_SIMD_SSE)
+
+float hsum(__m128 v) {
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, v);
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+// x[j .. j + 4) - p computed in double, narrowed to float
+__m128 separation(const double* x, __m128d p) {
+    __m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_load_pd(x), p));
+    __m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_load_pd(x + 2), p));
+    return _mm_movelh_ps(lo, hi);
+}
+
+template <bool Wide>
+Accel accumulate(const BodyStore& b, std::size_t begin, std::size_t end,
+                 double px, double py, double pz, float eps2)
+{
+    const std::size_t nv = begin + ((end - begin) & ~std::size_t(3));
+
+    const __m128 vpx = _mm_set1_ps((float)px);
+    const __m128 vpy = _mm_set1_ps((float)py);
+    const __m128 vpz = _mm_set1_ps((float)pz);
+    const __m128d wpx = _mm_set1_pd(px);
+    const __m128d wpy = _mm_set1_pd(py);
+    const __m128d wpz = _mm_set1_pd(pz);
+    const __m128 veps2 = _mm_set1_ps(eps2);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    __m128 sx = zero, sy = zero, sz = zero;
+    for (std::size_t j = begin; j < nv; j += 4) {
+        __m128 dx, dy, dz;
+        if constexpr (Wide) {
+            dx = separation(&b.xd[j], wpx);
+            dy = separation(&b.yd[j], wpy);
+            dz = separation(&b.zd[j], wpz);
+        } else {
+            dx = _mm_sub_ps(_mm_load_ps(&b.x[j]), vpx);
+            dy = _mm_sub_ps(_mm_load_ps(&b.y[j]), vpy);
+            dz = _mm_sub_ps(_mm_load_ps(&b.z[j]), vpz);
+        }
+
+        __m128 r2 = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+            _mm_add_ps(_mm_mul_ps(dz, dz), veps2));
+
+        __m128 valid = _mm_cmpgt_ps(r2, zero);
+        __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(r2));
+        __m128 s = _mm_mul_ps(_mm_load_ps(&b.mass[j]),
+                              _mm_mul_ps(inv, _mm_mul_ps(inv, inv)));
+        s = _mm_and_ps(s, valid);
+
+        sx = _mm_add_ps(sx, _mm_mul_ps(dx, s));
+        sy = _mm_add_ps(sy, _mm_mul_ps(dy, s));
+        sz = _mm_add_ps(sz, _mm_mul_ps(dz, s));
+    }
+
+    Accel tail = accumulateScalar<Wide>(b, nv, end, px, py, pz, eps2);
+    return { hsum(sx) + tail.x, hsum(sy) + tail.y, hsum(sz) + tail.z };
+}
+
+#else
+
+template <bool Wide>
+Accel accumulate(const BodyStore& b, std::size_t begin, std::size_t end,
+                 double px, double py, double pz, float eps2)
+{
+    return accumulateScalar<Wide>(b, begin, end, px, py, pz, eps2);
+}
+
+#endif
+
+// The r^2, rsqrt and multiplies are always float. A double accumulator
+// (mixed precision) takes one float partial sum per tile, so rounding no
+// longer grows with N, for a handful of extra scalar adds; a float
+// accumulator sums everything in one pass. Tiles start at multiples of
+// ACCUMULATE_TILE, keeping the vector loads aligned.
+template <typename Acc>
+void accumulateTiled(const BodyStore& b, double px, double py, double pz, float eps2,
+                     Acc& sx, Acc& sy, Acc& sz)
+{
+    constexpr bool wide = std::is_same<Acc, double>::value;
+    const std::size_t n = b.size();
+    const std::size_t tile = wide ? ACCUMULATE_TILE : n;
+    for (std::size_t begin = 0; begin < n; begin += tile) {
+        Accel a = accumulate<wide>(b, begin, std::min(n, begin + tile), px, py, pz, eps2);
+        sx += a.x;
+        sy += a.y;
+        sz += a.z;
+    }
+}
+
+template <typename Acc>
+void directRange(BodyStore& bodies, const GravityParams& params, const ActiveList* active,
+                 std::size_t begin, std::size_t end)
+{
+    const float eps2 = params.softening * params.softening;
+    for (std::size_t k = begin; k < end; k++) {
+        std::size_t i = active ? (*active)[k] : k;
+        Acc sx = 0, sy = 0, sz = 0;
+        if constexpr (std::is_same<Acc, double>::value)
+            accumulateTiled(bodies, bodies.xd[i], bodies.yd[i], bodies.zd[i], eps2, sx, sy, sz);
+        else
+            accumulateTiled(bodies, bodies.x[i], bodies.y[i], bodies.z[i], eps2, sx, sy, sz);
+        bodies.ax[i] = (float)(params.G * sx);
+        bodies.ay[i] = (float)(params.G * sy);
+        bodies.az[i] = (float)(params.G * sz);
+    }
+}
+
+} // namespace
+
+void computeAccelerationsDirect(BodyStore& bodies, const GravityParams& params,
+                                ThreadPool* pool, const ActiveList* active)
+{
+    const std::size_t count = active ? active->size() : bodies.size();
+    const bool mixed = bodies.mixed();
+
+    auto range = [&](std::size_t begin, std::size_t end) {
+        if (mixed)
+            directRange<double>(bodies, params, active, begin, end);
+        else
+            directRange<float>(bodies, params, active, begin, end);
+    };
+
+    if (pool)
+        pool->parallelFor(count, 64, range);
+    else
+        range(0, count);
+}
+
+const char* solverName(Solver solver) {
+    switch (solver) {
+    case Solver::Direct:       return "direct";
+    case Solver::BarnesHut:    return "barnes-hut";
+    case Solver::ParticleMesh: return "particle-mesh";
+    }
+    return "unknown";
+}
+
+const char* directKernelName() {
+#if defined(GRAVITY_SIMD_AVX2)
+    return "avx2";
+#elif defined(GRAVITY_SIMD_SSE)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
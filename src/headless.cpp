@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "profiler.hpp"
+#include "scenario.hpp"
+#include "simulation.hpp"
+#include "snapshot.hpp"
+
+namespace {
+
+struct Options {
+    std::size_t bodies = 10000;
+    int steps = 100;
+    float dt = 0.001f;
+    Solver solver = Solver::BarnesHut;
+    Integrator integrator = Integrator::Leapfrog;
+    Precision precision = Precision::Single;
+    int blockLevels = 0;
+    float eta = 0.025f;
+    float theta = 0.5f;
+    int pmGrid = 64;
+    PmBoundary pmBoundary = PmBoundary::Isolated;
+    float pmBox = 0.0f;
+    float softening = 0.05f;
+    unsigned threads = 0;
+    unsigned seed = 1;
+    std::string scenario = "plummer";
+    bool energy = false;
+    bool collisions = false;
+    std::string recordPath;
+    int recordEvery = 1;
+    bool quantize = false;
+    std::string tracePath;
+};
+
+void printUsage(const char* exe) {
+    std::cout
+        << "usage: " << exe << " [options]\n"
+        << "  --bodies N        number of bodies (default 10000)\n"
+        << "  --steps N         steps to run (default 100)\n"
+        << "  --dt T            timestep (default 0.001)\n"
+        << "  --solver S        direct | barnes-hut | pm (default barnes-hut)\n"
+        << "  --theta T         Barnes-Hut opening angle (default 0.5)\n"
+        << "  --pm-grid N       particle-mesh grid cells per side, power of two (default 64)\n"
+        << "  --pm-boundary B   isolated | periodic (default isolated)\n"
+        << "  --pm-box L        periodic box size centred on the origin (default: fit once)\n"
+        << "  --integrator I    leapfrog | yoshida4 (default leapfrog)\n"
+        << "  --precision P     single | mixed: double positions, velocities and force sums (default single)\n"
+        << "  --block-levels N  individual block timesteps down to dt / 2^N, N <= 20 (default off)\n"
+        << "  --eta E           block timestep accuracy parameter (default 0.025)\n"
+        << "  --softening E     softening length (default 0.05)\n"
+        << "  --threads N       worker threads, 0 = all cores (default 0)\n"
+        << "  --scenario S      plummer | disk (default plummer)\n"
+        << "  --seed N          random seed (default 1)\n"
+        << "  --energy          report energy drift (O(N^2) at start and end)\n"
+        << "  --collisions      merge overlapping bodies\n"
+        << "  --record FILE     write a snapshot file\n"
+        << "  --record-every N  snapshot every N steps (default 1)\n"
+        << "  --quantize        store snapshot positions as 16-bit fixed point\n"
+        << "  --trace FILE      write phase timings as Chrome trace-event JSON\n";
+}
+
+bool parseSolver(const char* s, Solver& out) {
+    if (std::strcmp(s, "direct") == 0)     { out = Solver::Direct;    return true; }
+    if (std::strcmp(s, "barnes-hut") == 0) { out = Solver::BarnesHut; return true; }
+    if (std::strcmp(s, "bh") == 0)         { out = Solver::BarnesHut; return true; }
+    if (std::strcmp(s, "pm") == 0)         { out = Solver::ParticleMesh; return true; }
+    return false;
+}
+
+bool parseBoundary(const char* s, PmBoundary& out) {
+    if (std::strcmp(s, "isolated") == 0) { out = PmBoundary::Isolated; return true; }
+    if (std::strcmp(s, "periodic") == 0) { out = PmBoundary::Periodic; return true; }
+    return false;
+}
+
+bool parseIntegrator(const char* s, Integrator& out) {
+    if (std::strcmp(s, "leapfrog") == 0) { out = Integrator::Leapfrog; return true; }
+    if (std::strcmp(s, "yoshida4") == 0) { out = Integrator::Yoshida4; return true; }
+    return false;
+}
+
+bool parsePrecision(const char* s, Precision& out) {
+    if (std::strcmp(s, "single") == 0) { out = Precision::Single; return true; }
+    if (std::strcmp(s, "mixed") == 0)  { out = Precision::Mixed;  return true; }
+    return false;
+}
+
+bool parseArgs(int argc, char** argv, Options& opt) {
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        bool hasValue = i + 1 < argc;
+
+        if (std::strcmp(a, "--help") == 0 || std::strcmp(a, "-h") == 0) {
+            printUsage(argv[0]);
+            std::exit(0);
+        } else if (std::strcmp(a, "--energy") == 0) {
+            opt.energy = true;
+        } else if (std::strcmp(a, "--collisions") == 0) {
+            opt.collisions = true;
+        } else if (std::strcmp(a, "--quantize") == 0) {
+            opt.quantize = true;
+        } else if (!hasValue) {
+            std::cerr << "missing value for " << a << "\n";
+            return false;
+        } else if (std::strcmp(a, "--bodies") == 0) {
+            opt.bodies = (std::size_t)std::strtoull(argv[++i], nullptr, 10);
+        } else if (std::strcmp(a, "--steps") == 0) {
+            opt.steps = std::atoi(argv[++i]);
+        } else if (std::strcmp(a, "--dt") == 0) {
+            opt.dt = std::strtof(argv[++i], nullptr);
+        } else if (std::strcmp(a, "--solver") == 0) {
+            if (!parseSolver(argv[++i], opt.solver)) {
+                std::cerr << "unknown solver " << argv[i] << "\n";
+                return false;
+            }
+        } else if (std::strcmp(a, "--integrator") == 0) {
+            if (!parseIntegrator(argv[++i], opt.integrator)) {
+                std::cerr << "unknown integrator " << argv[i] << "\n";
+                return false;
+            }
+        } else if (std::strcmp(a, "--precision") == 0) {
+            if (!parsePrecision(argv[++i], opt.precision)) {
+                std::cerr << "unknown precision " << argv[i] << "\n";
+                return false;
+            }
+        } else if (std::strcmp(a, "--block-levels") == 0) {
+            opt.blockLevels = std::atoi(argv[++i]);
+            if (opt.blockLevels < 0 || opt.blockLevels > BlockTimestepParams::MAX_LEVEL) {
+                std::cerr << "--block-levels must be between 0 and "
+                          << BlockTimestepParams::MAX_LEVEL << "\n";
+                return false;
+            }
+        } else if (std::strcmp(a, "--eta") == 0) {
+            opt.eta = std::strtof(argv[++i], nullptr);
+        } else if (std::strcmp(a, "--theta") == 0) {
+            opt.theta = std::strtof(argv[++i], nullptr);
+        } else if (std::strcmp(a, "--pm-grid") == 0) {
+            opt.pmGrid = std::atoi(argv[++i]);
+        } else if (std::strcmp(a, "--pm-boundary") == 0) {
+            if (!parseBoundary(argv[++i], opt.pmBoundary)) {
+                std::cerr << "unknown boundary " << argv[i] << "\n";
+                return false;
+            }
+        } else if (std::strcmp(a, "--pm-box") == 0) {
+            opt.pmBox = std::strtof(argv[++i], nullptr);
+        } else if (std::strcmp(a, "--softening") == 0) {
+            opt.softening = std::strtof(argv[++i], nullptr);
+        } else if (std::strcmp(a, "--threads") == 0) {
+            opt.threads = (unsigned)std::atoi(argv[++i]);
+        } else if (std::strcmp(a, "--scenario") == 0) {
+            opt.scenario = argv[++i];
+        } else if (std::strcmp(a, "--record") == 0) {
+            opt.recordPath = argv[++i];
+        } else if (std::strcmp(a, "--record-every") == 0) {
+            opt.recordEvery = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(a, "--trace") == 0) {
+            opt.tracePath = argv[++i];
+        } else if (std::strcmp(a, "--seed") == 0) {
+            opt.seed = (unsigned)std::atoi(argv[++i]);
+        } else {
+            std::cerr << "unknown option " << a << "\n";
+            return false;
+        }
+    }
+
+    if (opt.scenario != "plummer" && opt.scenario != "disk") {
+        std::cerr << "unknown scenario " << opt.scenario << "\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    Simulation sim(opt.threads);
+    sim.setSolver(opt.solver);
+    sim.tree().setTheta(opt.theta);
+    sim.pm().setGridSize(opt.pmGrid);
+    sim.pm().setBoundary(opt.pmBoundary);
+    if (opt.pmBox > 0.0f)
+        sim.pm().setPeriodicBox({ -0.5f * opt.pmBox, -0.5f * opt.pmBox, -0.5f * opt.pmBox }, opt.pmBox);
+    sim.gravity().softening = opt.softening;
+    sim.setIntegrator(opt.integrator);
+    sim.setPrecision(opt.precision);
+    sim.setCollisions(opt.collisions);
+    sim.blockTimesteps().enabled = opt.blockLevels > 0;
+    sim.blockTimesteps().maxLevel = opt.blockLevels;
+    sim.blockTimesteps().eta = opt.eta;
+
+    if (opt.scenario == "disk")
+        makeDisk(sim.bodies(), opt.bodies, opt.seed, sim.gravity());
+    else
+        makePlummer(sim.bodies(), opt.bodies, opt.seed, sim.gravity());
+
+    std::cout << "bodies:   " << sim.bodies().size() << "\n"
+              << "solver:   " << solverName(sim.solver());
+    if (sim.solver() == Solver::BarnesHut)
+        std::cout << " (theta " << sim.tree().theta() << ")";
+    if (sim.solver() == Solver::ParticleMesh)
+        std::cout << " (" << sim.pm().gridSize() << "^3 " << pmBoundaryName(sim.pm().boundary())
+                  << ", fft " << Fft3D::backendName() << ")";
+    std::cout << "\n"
+              << "kernel:   " << directKernelName() << "\n"
+              << "stepping: ";
+    if (opt.blockLevels > 0)
+        std::cout << "block leapfrog, " << opt.blockLevels << " levels, eta " << opt.eta << "\n";
+    else
+        std::cout << integratorName(opt.integrator) << "\n";
+    std::cout << "precision: " << precisionName(sim.precision()) << "\n";
+    std::cout
+              << "threads:  " << sim.pool().threadCount() << "\n"
+              << "steps:    " << opt.steps << " x dt " << opt.dt << "\n";
+
+    SnapshotWriter recorder;
+    if (!opt.recordPath.empty()) {
+        auto encoding = opt.quantize ? PositionEncoding::Quantized16 : PositionEncoding::Float32;
+        if (!recorder.open(opt.recordPath, encoding)) {
+            std::cerr << "cannot open " << opt.recordPath << " for writing\n";
+            return 1;
+        }
+        recorder.submit(sim.bodies(), sim.stepCount(), sim.time());
+    }
+
+    Profiler::instance().setThreadName("main");
+    if (!opt.tracePath.empty()) {
+#ifndef GRAVITY_SIM_PROFILE
+        std::cerr << "built without GRAVITY_SIM_PROFILE, the trace will be empty\n";
+#endif
+        Profiler::instance().setTracing(true);
+    }
+
+    double e0 = 0.0;
+    if (opt.energy)
+        e0 = sim.kineticEnergy() + sim.potentialEnergy();
+
+    StepTimings total;
+    double interactions = 0.0;
+    double forceEvaluations = 0.0;
+    std::size_t merges = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < opt.steps; s++) {
+        sim.step(opt.dt);
+
+        const StepTimings& t = sim.lastTimings();
+        total.tree += t.tree;
+        total.force += t.force;
+        total.integrate += t.integrate;
+        total.collide += t.collide;
+        interactions += (double)sim.lastInteractions();
+        forceEvaluations += (double)sim.lastForceEvaluations();
+        merges += sim.lastMerges();
+
+        if (recorder.isOpen() && sim.stepCount() % opt.recordEvery == 0) {
+            PROFILE_SCOPE("record");
+            recorder.submit(sim.bodies(), sim.stepCount(), sim.time());
+        }
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const double steps = opt.steps > 0 ? opt.steps : 1;
+    std::cout << std::fixed << std::setprecision(3)
+              << "\nwall:         " << elapsed << " s\n"
+              << "steps/sec:    " << opt.steps / elapsed << "\n"
+              << std::scientific << std::setprecision(3)
+              << "interact/sec: " << interactions / elapsed << "\n"
+              << "force evals per body per unit time: "
+              << forceEvaluations / ((double)sim.bodies().size() * opt.steps * opt.dt) << "\n"
+              << std::fixed
+              << "per step:     tree " << 1e3 * total.tree / steps << " ms"
+              << ", force " << 1e3 * total.force / steps << " ms"
+              << ", integrate " << 1e3 * total.integrate / steps << " ms"
+              << ", collide " << 1e3 * total.collide / steps << " ms\n";
+
+    const std::vector<PhaseSummary> phases = Profiler::instance().summary();
+    if (!phases.empty()) {
+        std::cout << "phases:       ms over the last " << PhaseHistogram::DEFAULT_WINDOW << " samples\n";
+        for (const PhaseSummary& p : phases) {
+            std::cout << "  " << std::left << std::setw(10) << p.name << std::right
+                      << " p50 " << std::setw(8) << p.p50Ms
+                      << "  p99 " << std::setw(8) << p.p99Ms << "\n";
+        }
+    }
+
+    if (opt.collisions)
+        std::cout << "merges:       " << merges << " (" << sim.bodies().size() << " bodies left)\n";
+
+    if (recorder.isOpen()) {
+        bool ok = recorder.close();
+        std::cout << "recorded:     " << recorder.framesWritten() << " frames ("
+                  << recorder.framesDropped() << " dropped) to " << opt.recordPath << "\n";
+        if (!ok) {
+            std::cerr << "write error while recording " << opt.recordPath
+                      << ", only the first " << recorder.framesWritten() << " frames were kept\n";
+            return 1;
+        }
+    }
+
+    if (!opt.tracePath.empty()) {
+        if (Profiler::instance().writeChromeTrace(opt.tracePath)) {
+            std::cout << "trace:        " << opt.tracePath;
+            if (std::size_t dropped = Profiler::instance().traceEventsDropped())
+                std::cout << " (" << dropped << " events dropped)";
+            std::cout << "\n";
+        } else {
+            std::cerr << "cannot write " << opt.tracePath << "\n";
+        }
+    }
+
+    if (opt.energy) {
+        double e1 = sim.kineticEnergy() + sim.potentialEnergy();
+        std::cout << std::scientific << std::setprecision(6)
+                  << "energy:       " << e0 << " -> " << e1
+                  << " (rel drift " << (e1 - e0) / std::abs(e0) << ")\n";
+    }
+
+    return 0;
+}
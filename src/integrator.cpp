@@ -0,0 +1,23 @@
+#include "integrator.hpp"
+
+const char* integratorName(Integrator integrator) {
+    switch (integrator) {
+    case Integrator::Leapfrog: return "leapfrog";
+    case Integrator::Yoshida4: return "yoshida4";
+    }
+    return "unknown";
+}
+
+int FixedTimestep::consume(float elapsed) {
+    accumulator += elapsed;
+
+    int steps = 0;
+    while (accumulator >= dt && steps < maxStepsPerFrame) {
+        accumulator -= dt;
+        steps++;
+    }
+
+    if (steps == maxStepsPerFrame && accumulator >= dt)
+        accumulator = 0.0f;
+    return steps;
+}
@@ -3,13 +3,101 @@
 #include <cmath>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <optional>
+#include <string>
 
 #include "math.hpp"
+#include "profiler.hpp"
+#include "renderer.hpp"
+#include "scenario.hpp"
+#include "sim_thread.hpp"
+#include "simulation.hpp"
+#include "snapshot.hpp"
+
+namespace {
+
+const char* const FONT_CANDIDATES[] = {
+    "C:/Windows/Fonts/consola.ttf",
+    "C:/Windows/Fonts/cour.ttf",
+    "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf",
+    "/usr/share/fonts/TTF/DejaVuSansMono.ttf",
+    "/usr/share/fonts/dejavu/DejaVuSansMono.ttf",
+    "/usr/share/fonts/truetype/liberation/LiberationMono-Regular.ttf",
+    "/System/Library/Fonts/Menlo.ttc",
+    "/Library/Fonts/Courier New.ttf",
+};
+
+bool loadOverlayFont(sf::Font& font, const char* path) {
+    if (path)
+        return font.openFromFile(path);
+    for (const char* candidate : FONT_CANDIDATES) {
+        if (font.openFromFile(candidate))
+            return true;
+    }
+    return false;
+}
+
+std::string formatPhases(const std::vector<PhaseSummary>& phases) {
+    std::string out = "phase          last    p50    p99 (ms)\n";
+    char line[96];
+    for (const PhaseSummary& p : phases) {
+        std::snprintf(line, sizeof(line), "%-10s %7.2f %6.2f %6.2f\n",
+                      p.name, p.lastMs, p.p50Ms, p.p99Ms);
+        out += line;
+    }
+    return out;
+}
 
+} // namespace
 
-int main()
+int main(int argc, char** argv)
 {
+    unsigned threads = 0;
+    std::size_t diskBodies = 0;
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* fontPath = nullptr;
+    bool collisions = false;
+    bool mixedPrecision = false;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threads = (unsigned)std::atoi(argv[++i]);
+        else if (std::strcmp(argv[i], "--bodies") == 0 && i + 1 < argc)
+            diskBodies = (std::size_t)std::atol(argv[++i]);
+        else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (std::strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (std::strcmp(argv[i], "--font") == 0 && i + 1 < argc)
+            fontPath = argv[++i];
+        else if (std::strcmp(argv[i], "--collisions") == 0)
+            collisions = true;
+        else if (std::strcmp(argv[i], "--mixed") == 0)
+            mixedPrecision = true;
+    }
 
+    // replay mode plays a snapshot file back instead of simulating;
+    // space pauses, left/right step one frame
+    SnapshotReader replay;
+    BodyStore replayBodies;
+    std::size_t replayFrame = 0;
+    bool replayPaused = false;
+    if (replayPath) {
+        if (!replay.open(replayPath) || replay.frameCount() == 0) {
+            std::cerr << "cannot read snapshot file " << replayPath << "\n";
+            return 1;
+        }
+        std::cout << "replaying " << replay.frameCount() << " frames\n";
+    }
+
+    SnapshotWriter recorder;
+    if (recordPath && !replayPath && !recorder.open(recordPath)) {
+        std::cerr << "cannot open " << recordPath << " for writing\n";
+        return 1;
+    }
 
     const int W = 800;
     const int H = 800;
@@ -32,152 +120,212 @@ int main()
 
     sf::Clock clock;
 
-    //test sphere
+    Simulation sim(threads);
+    sim.setCollisions(collisions);
+    if (mixedPrecision)
+        sim.setPrecision(Precision::Mixed);
+    std::cout << "threads: " << sim.pool().threadCount() << "\n";
 
-    Vec3D spherePos{0, 0, 0};
-    float sphereRadius = 1.0f;
+    BodyStore& bodies = sim.bodies();
+    if (diskBodies > 0)
+        makeDisk(bodies, diskBodies, 1, sim.gravity());
+    else
+        makeStarSystem(bodies, sim.gravity());
 
-    Vec3D lightDirWorld = normalize({ 0.3f, 0.7f, 0.6f });
+    // physics runs on its own thread at a fixed step regardless of frame
+    // rate; the UI thread only reads published snapshots and keeps the camera
+    Solver solver = sim.solver();
+    float theta = sim.tree().theta();
+
+    SimulationThread simThread(sim, 1.0f / 240.0f);
+    if (recorder.isOpen())
+        simThread.setRecorder(&recorder);
+    if (!replay.isOpen())
+        simThread.start();
+
+    StateInterpolator interpolator;
+    sf::Clock wallClock;
 
+    Vec3D lightDirWorld = normalize({ 0.3f, 0.7f, 0.6f });
+    BodyRenderer renderer;
+
+    // F3 toggles the phase timing overlay; without a usable font the same
+    // table goes to the console once a second
+    Profiler::instance().setThreadName("main");
+    bool showOverlay = false;
+    sf::Font overlayFont;
+    std::optional<sf::Text> overlay;
+    if (loadOverlayFont(overlayFont, fontPath)) {
+        overlay.emplace(overlayFont, "", 13);
+        overlay->setFillColor(sf::Color(200, 200, 200));
+        overlay->setPosition({ 8.0f, 8.0f });
+    } else {
+        std::cerr << "no overlay font found (try --font), profiling overlay goes to the console\n";
+    }
+    sf::Clock overlayClock;
+    bool recordFailureReported = false;
 
     while (window.isOpen()) {
-        while (auto ev = window.pollEvent()) {
-            if (ev->is<sf::Event::Closed>())
-                window.close();
-
-            if (const auto* mb = ev->getIf<sf::Event::MouseButtonPressed>()) {
-                if (mb->button == sf::Mouse::Button::Left) {
-                    dragging = true;
-                    lastMousePos = mb->position;
+        {
+            PROFILE_SCOPE("input");
+            while (auto ev = window.pollEvent()) {
+                if (ev->is<sf::Event::Closed>())
+                    window.close();
+
+                if (const auto* mb = ev->getIf<sf::Event::MouseButtonPressed>()) {
+                    if (mb->button == sf::Mouse::Button::Left) {
+                        dragging = true;
+                        lastMousePos = mb->position;
+                    }
                 }
-            }
 
-            if (const auto* mb = ev->getIf<sf::Event::MouseButtonReleased>()) {
-                if (mb->button == sf::Mouse::Button::Left) {
-                    dragging = false;
+                if (const auto* mb = ev->getIf<sf::Event::MouseButtonReleased>()) {
+                    if (mb->button == sf::Mouse::Button::Left) {
+                        dragging = false;
+                    }
                 }
-            }
 
-            if (const auto* mm = ev->getIf<sf::Event::MouseMoved>()) {
-                if (dragging) {
-                    sf::Vector2i cur = mm->position;
-                    sf::Vector2i delta = cur - lastMousePos;
-                    lastMousePos = cur;
+                if (const auto* mm = ev->getIf<sf::Event::MouseMoved>()) {
+                    if (dragging) {
+                        sf::Vector2i cur = mm->position;
+                        sf::Vector2i delta = cur - lastMousePos;
+                        lastMousePos = cur;
 
-                    yaw   += delta.x * 0.005f;
-                    pitch += delta.y * 0.005f;
-                    pitch = std::clamp(pitch, -1.5f, 1.5f);
+                        yaw   += delta.x * 0.005f;
+                        pitch += delta.y * 0.005f;
+                        pitch = std::clamp(pitch, -1.5f, 1.5f);
+                    }
                 }
-            }
 
-            if (const auto* mw = ev->getIf<sf::Event::MouseWheelScrolled>()) {
-                dz -= mw->delta * 0.5f;
-                dz = std::clamp(dz, 1.0f, 20.0f);
+                if (const auto* mw = ev->getIf<sf::Event::MouseWheelScrolled>()) {
+                    dz -= mw->delta * 0.5f;
+                    dz = std::clamp(dz, 1.0f, 20.0f);
+                }
+
+                if (const auto* kp = ev->getIf<sf::Event::KeyPressed>()) {
+                    if (kp->code == sf::Keyboard::Key::F3)
+                        showOverlay = !showOverlay;
+                    if (kp->code == sf::Keyboard::Key::B) {
+                        if (solver == Solver::Direct)
+                            solver = Solver::BarnesHut;
+                        else if (solver == Solver::BarnesHut)
+                            solver = Solver::ParticleMesh;
+                        else
+                            solver = Solver::Direct;
+                        simThread.requestSolver(solver);
+                        std::cout << "solver: " << solverName(solver) << "\n";
+                    }
+                    if (kp->code == sf::Keyboard::Key::LBracket || kp->code == sf::Keyboard::Key::RBracket) {
+                        float step = kp->code == sf::Keyboard::Key::LBracket ? -0.1f : 0.1f;
+                        theta = std::clamp(theta + step, 0.0f, 2.0f);
+                        simThread.requestTheta(theta);
+                        std::cout << "theta: " << theta << "\n";
+                    }
+                    if (replay.isOpen()) {
+                        if (kp->code == sf::Keyboard::Key::Space)
+                            replayPaused = !replayPaused;
+                        if (kp->code == sf::Keyboard::Key::Left && replayFrame > 0)
+                            replayFrame--;
+                        if (kp->code == sf::Keyboard::Key::Right && replayFrame + 1 < replay.frameCount())
+                            replayFrame++;
+                    }
+                }
             }
-        }
 
-        float dt = clock.restart().asSeconds();
+            float dt = clock.restart().asSeconds();
 
-        Vec3D forward = {
-            std::sin(yaw),
-            0,
-            std::cos(yaw)
-        };
-        Vec3D right = {
-            std::cos(yaw),
-            0,
-            -std::sin(yaw)
-        };
+            Vec3D forward = {
+                std::sin(yaw),
+                0,
+                std::cos(yaw)
+            };
+            Vec3D right = {
+                std::cos(yaw),
+                0,
+                -std::sin(yaw)
+            };
 
-        float speed = 3.0f * dt;
+            float speed = 3.0f * dt;
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W)) {
-            camOffset.x += forward.x * speed;
-            camOffset.z += forward.z * speed;
-        }
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::W)) {
+                camOffset.x += forward.x * speed;
+                camOffset.z += forward.z * speed;
+            }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S)) {
-            camOffset.x -= forward.x * speed;
-            camOffset.z -= forward.z * speed;
-        }
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::S)) {
+                camOffset.x -= forward.x * speed;
+                camOffset.z -= forward.z * speed;
+            }
+
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A)) {
+                camOffset.x -= right.x * speed;
+                camOffset.z -= right.z * speed;
+            }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::A)) {
-            camOffset.x -= right.x * speed;
-            camOffset.z -= right.z * speed;
+            if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D)) {
+                camOffset.x += right.x * speed;
+                camOffset.z += right.z * speed;
+            }
         }
 
-        if (sf::Keyboard::isKeyPressed(sf::Keyboard::Key::D)) {
-            camOffset.x += right.x * speed;
-            camOffset.z += right.z * speed;
+        BodyView shown;
+        {
+            PROFILE_SCOPE("physics");
+            if (replay.isOpen()) {
+                replay.readFrame(replayFrame, replayBodies);
+                shown = replayBodies.view();
+                if (!replayPaused && replayFrame + 1 < replay.frameCount())
+                    replayFrame++;
+            } else {
+                double now = wallClock.getElapsedTime().asSeconds();
+                if (simThread.snapshots().update())
+                    interpolator.push(simThread.snapshots().readBuffer(), now);
+                shown = interpolator.at(now);
+            }
         }
 
+        // the writer stops taking frames after a short write; say so now
+        // instead of only when the window closes
+        if (recorder.isOpen() && !recordFailureReported && recorder.failed()) {
+            std::cerr << "write error while recording " << recordPath << ", recording stopped after "
+                      << recorder.framesWritten() << " frames\n";
+            recordFailureReported = true;
+        }
 
-        // apply gravity here
-        
         window.clear(sf::Color(16, 16, 16));
 
         // draw bodies
 
-        Vec3D worldPos = {
-            spherePos.x - camOffset.x,
-            spherePos.y - camOffset.y,
-            spherePos.z - camOffset.z
-        };
-
-        Vec3D view = toViewSpace(worldPos, pitch, yaw, roll, dz);
-
-        Vec3D lightDirView = normalize(
-            rotate_xy(
-                rotate_xz(
-                    rotate_yz(lightDirWorld, pitch),
-                    yaw
-                ),
-                roll
-            )
-        );
-
-        if (view.z > NEAR_PLANE_THRESHOLD) {
-            Vec2D p = screen(project(view), W, H);
-
-            float r = sphereRadius / view.z * W;
-            sf::Image sphereImg(
-                sf::Vector2u((unsigned)(2*r), (unsigned)(2*r)),
-                sf::Color::Transparent
-            );
-
-            for (int y = 0; y < (int)(2*r); y++) {
-                for (int x = 0; x < (int)(2*r); x++) {
-                    float nx = (x - r) / r;
-                    float ny = (y - r) / r;
-
-                    float d2 = nx*nx + ny*ny;
-                    if (d2 > 1.0f)
-                        continue;
-
-                    float nz = std::sqrt(1.0f - d2);
-
-                    Vec3D N = normalize({ nx, ny, nz });
-                    float lambert = std::max(0.15f, dot(N, lightDirView));
-
-                    uint8_t c = static_cast<uint8_t>(lambert * 255);
-                    sphereImg.setPixel(
-                        { (unsigned)x, (unsigned)y },
-                        sf::Color(c, c, c)
-                    );
-                }
-            }
+        CameraMatrix camera = makeCameraMatrix(pitch, yaw, roll, dz, camOffset);
+        Vec3D lightDirView = normalize(rotate(camera, lightDirWorld));
 
-            sf::Texture sphereTex;
-            sphereTex.loadFromImage(sphereImg);
+        renderer.draw(window, shown, camera, lightDirView);
 
-            sf::Sprite sphereSprite(sphereTex);
-            sphereSprite.setPosition({ p.x - r, p.y - r });
-
-            window.draw(sphereSprite);
+        if (showOverlay) {
+            bool refresh = overlayClock.getElapsedTime().asSeconds() >= (overlay ? 0.25f : 1.0f);
+            if (refresh) {
+                overlayClock.restart();
+                std::string table = formatPhases(Profiler::instance().summary());
+                if (overlay)
+                    overlay->setString(table);
+                else
+                    std::cout << table;
+            }
+            if (overlay)
+                window.draw(*overlay);
+        }
 
+        {
+            PROFILE_SCOPE("display");
+            window.display();
         }
+    }
 
-        window.display();
+    simThread.stop();
+    if (recorder.isOpen() && !recorder.close()) {
+        std::cerr << "write error while recording " << recordPath
+                  << ", only the first " << recorder.framesWritten() << " frames were kept\n";
+        return 1;
     }
 
     return 0;
@@ -1,24 +1,28 @@
 #include "math.hpp"
+#include "simd.hpp"
 
-Vec2D project(const Vec3D& p) {
-    if (p.z <= NEAR_PLANE_THRESHOLD)
-        return { NAN, NAN };
-    return Vec2D{
+template <typename T>
+Vec2<T> project(const Vec3<T>& p) {
+    if (p.z <= T(NEAR_PLANE_THRESHOLD))
+        return { T(NAN), T(NAN) };
+    return Vec2<T>{
         p.x / (p.z),
         p.y / (p.z)
     };
 }
 
-Vec2D screen(const Vec2D& p, int w, int h) {
+template <typename T>
+Vec2<T> screen(const Vec2<T>& p, int w, int h) {
     return {
-        (p.x + 1.0f) * 0.5f * w,
-        (1.0f - (p.y + 1.0f) * 0.5f) * h
+        (p.x + T(1)) * T(0.5) * w,
+        (T(1) - (p.y + T(1)) * T(0.5)) * h
     };
 }
 
-Vec3D rotate_xz(const Vec3D& p, float angle) {
-    float cos_a = std::cos(angle);
-    float sin_a = std::sin(angle);
+template <typename T>
+Vec3<T> rotate_xz(const Vec3<T>& p, typename Vec3<T>::Scalar angle) {
+    T cos_a = std::cos(angle);
+    T sin_a = std::sin(angle);
     return {
         p.x * cos_a - p.z * sin_a,
         p.y,
@@ -26,9 +30,10 @@ Vec3D rotate_xz(const Vec3D& p, float angle) {
     };
 }
 
-Vec3D rotate_yz(const Vec3D& p, float angle) {
-    float cos_a = std::cos(angle);
-    float sin_a = std::sin(angle);
+template <typename T>
+Vec3<T> rotate_yz(const Vec3<T>& p, typename Vec3<T>::Scalar angle) {
+    T cos_a = std::cos(angle);
+    T sin_a = std::sin(angle);
     return {
         p.x,
         p.y * cos_a - p.z * sin_a,
@@ -36,9 +41,10 @@ Vec3D rotate_yz(const Vec3D& p, float angle) {
     };
 }
 
-Vec3D rotate_xy(const Vec3D& p, float angle) {
-    float cos_a = std::cos(angle);
-    float sin_a = std::sin(angle);
+template <typename T>
+Vec3<T> rotate_xy(const Vec3<T>& p, typename Vec3<T>::Scalar angle) {
+    T cos_a = std::cos(angle);
+    T sin_a = std::sin(angle);
     return {
         p.x * cos_a - p.y * sin_a,
         p.x * sin_a + p.y * cos_a,
@@ -46,7 +52,8 @@ Vec3D rotate_xy(const Vec3D& p, float angle) {
     };
 }
 
-Vec3D translate_z(const Vec3D& p, float dz) {
+template <typename T>
+Vec3<T> translate_z(const Vec3<T>& p, typename Vec3<T>::Scalar dz) {
     return {
         p.x,
         p.y,
@@ -54,7 +61,8 @@ Vec3D translate_z(const Vec3D& p, float dz) {
     };
 }
 
-Vec3D cross(const Vec3D& a, const Vec3D& b) {
+template <typename T>
+Vec3<T> cross(const Vec3<T>& a, const Vec3<T>& b) {
     return {
         a.y * b.z - a.z * b.y,
         a.z * b.x - a.x * b.z,
@@ -62,25 +70,73 @@ Vec3D cross(const Vec3D& a, const Vec3D& b) {
     };
 }
 
-float dot(const Vec3D& a, const Vec3D& b) {
+template <typename T>
+T dot(const Vec3<T>& a, const Vec3<T>& b) {
     return a.x*b.x + a.y*b.y + a.z*b.z;
 }
 
-Vec3D normalize(const Vec3D& v) {
-    float len = std::sqrt(dot(v, v));
+template <typename T>
+Vec3<T> normalize(const Vec3<T>& v) {
+    T len = std::sqrt(dot(v, v));
     return { v.x/len, v.y/len, v.z/len };
 }
 
+#define INSTANTIATE_VECTOR_MATH(T)                                              \
+    template Vec2<T> project<T>(const Vec3<T>&);                                \
+    template Vec2<T> screen<T>(const Vec2<T>&, int, int);                       \
+    template Vec3<T> rotate_xz<T>(const Vec3<T>&, T);                           \
+    template Vec3<T> rotate_yz<T>(const Vec3<T>&, T);                           \
+    template Vec3<T> rotate_xy<T>(const Vec3<T>&, T);                           \
+    template Vec3<T> translate_z<T>(const Vec3<T>&, T);                         \
+    template Vec3<T> cross<T>(const Vec3<T>&, const Vec3<T>&);                  \
+    template T dot<T>(const Vec3<T>&, const Vec3<T>&);                          \
+    template Vec3<T> normalize<T>(const Vec3<T>&);
+
+INSTANTIATE_VECTOR_MATH(float)
+INSTANTIATE_VECTOR_MATH(double)
+
+#undef INSTANTIATE_VECTOR_MATH
+
 Vec3D toViewSpace(const Vec3D& v,
                   float ax, float ay, float az,
                   float dz)
 {
-    Vec3D p = v;
-    p = rotate_yz(p, ax);
-    p = rotate_xz(p, ay);
-    p = rotate_xy(p, az);
-    p = translate_z(p, dz);
-    return p;
+    return toViewSpace(makeCameraMatrix(ax, ay, az, dz), v);
+}
+
+CameraMatrix makeCameraMatrix(float ax, float ay, float az,
+                              float dz, const Vec3D& eye)
+{
+    // columns are the rotated basis vectors, so the matrix matches the
+    // rotate_* chain exactly
+    const Vec3D basis[3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+
+    CameraMatrix cam;
+    for (int c = 0; c < 3; c++) {
+        Vec3D col = rotate_xy(rotate_xz(rotate_yz(basis[c], ax), ay), az);
+        cam.m[0][c] = col.x;
+        cam.m[1][c] = col.y;
+        cam.m[2][c] = col.z;
+    }
+
+    Vec3D e = rotate(cam, eye);
+    cam.t[0] = -e.x;
+    cam.t[1] = -e.y;
+    cam.t[2] = -e.z + dz;
+    return cam;
+}
+
+Vec3D rotate(const CameraMatrix& cam, const Vec3D& v) {
+    return {
+        cam.m[0][0] * v.x + cam.m[0][1] * v.y + cam.m[0][2] * v.z,
+        cam.m[1][0] * v.x + cam.m[1][1] * v.y + cam.m[1][2] * v.z,
+        cam.m[2][0] * v.x + cam.m[2][1] * v.y + cam.m[2][2] * v.z
+    };
+}
+
+Vec3D toViewSpace(const CameraMatrix& cam, const Vec3D& v) {
+    Vec3D p = rotate(cam, v);
+    return { p.x + cam.t[0], p.y + cam.t[1], p.z + cam.t[2] };
 }
 
 bool clipLineToNearPlane(Vec3D& a, Vec3D& b, float nearZ) {
@@ -108,14 +164,125 @@ Vec2D transform(const Vec3D& v,
                 float ax, float ay, float az,
                 float dz, int w, int h)
 {
-    Vec3D p = v;
+    return transform(makeCameraMatrix(ax, ay, az, dz), v, w, h);
+}
 
-    p = rotate_yz(p, ax); // rotate around X
-    p = rotate_xz(p, ay); // rotate around Y
-    p = rotate_xy(p, az); // rotate around Z
+Vec2D transform(const CameraMatrix& cam, const Vec3D& v, int w, int h) {
+    Vec2D projected = project(toViewSpace(cam, v));
+    return screen(projected, w, h);
+}
 
-    p = translate_z(p, dz);
+namespace {
 
-    Vec2D projected = project(p);
-    return screen(projected, w, h);
+std::size_t laneCount(int mask) {
+    std::size_t c = 0;
+    for (; mask; mask >>= 1)
+        c += mask & 1;
+    return c;
+}
+
+std::size_t projectScalar(const CameraMatrix& cam,
+                          const float* x, const float* y, const float* z,
+                          std::size_t begin, std::size_t end, int w, int h,
+                          float* sx, float* sy, float* depth)
+{
+    std::size_t visible = 0;
+    for (std::size_t i = begin; i < end; i++) {
+        Vec3D v = toViewSpace(cam, { x[i], y[i], z[i] });
+        if (v.z <= NEAR_PLANE_THRESHOLD) {
+            sx[i] = sy[i] = NAN;
+            depth[i] = 0.0f;
+            continue;
+        }
+        Vec2D p = screen(project(v), w, h);
+        sx[i] = p.x;
+        sy[i] = p.y;
+        depth[i] = v.z;
+        visible++;
+    }
+    return visible;
+}
+
+} // namespace
+
+std::size_t projectToScreen(const CameraMatrix& cam,
+                            const float* x, const float* y, const float* z,
+                            std::size_t n, int w, int h,
+                            float* sx, float* sy, float* depth)
+{
+    std::size_t i = 0;
+    std::size_t visible = 0;
+
+#if defined(GRAVITY_SIMD_AVX2)
+    const __m256 m00 = _mm256_set1_ps(cam.m[0][0]), m01 = _mm256_set1_ps(cam.m[0][1]), m02 = _mm256_set1_ps(cam.m[0][2]);
+    const __m256 m10 = _mm256_set1_ps(cam.m[1][0]), m11 = _mm256_set1_ps(cam.m[1][1]), m12 = _mm256_set1_ps(cam.m[1][2]);
+    const __m256 m20 = _mm256_set1_ps(cam.m[2][0]), m21 = _mm256_set1_ps(cam.m[2][1]), m22 = _mm256_set1_ps(cam.m[2][2]);
+    const __m256 t0 = _mm256_set1_ps(cam.t[0]), t1 = _mm256_set1_ps(cam.t[1]), t2 = _mm256_set1_ps(cam.t[2]);
+    const __m256 halfW = _mm256_set1_ps(0.5f * w);
+    const __m256 halfH = _mm256_set1_ps(0.5f * h);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 nearZ = _mm256_set1_ps(NEAR_PLANE_THRESHOLD);
+    const __m256 nan = _mm256_set1_ps(NAN);
+
+    for (; i + 8 <= n; i += 8) {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+
+        __m256 vx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m00, px), _mm256_mul_ps(m01, py)),
+                                  _mm256_add_ps(_mm256_mul_ps(m02, pz), t0));
+        __m256 vy = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, px), _mm256_mul_ps(m11, py)),
+                                  _mm256_add_ps(_mm256_mul_ps(m12, pz), t1));
+        __m256 vz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m20, px), _mm256_mul_ps(m21, py)),
+                                  _mm256_add_ps(_mm256_mul_ps(m22, pz), t2));
+
+        __m256 inFront = _mm256_cmp_ps(vz, nearZ, _CMP_GT_OQ);
+        __m256 inv = _mm256_div_ps(one, vz);
+
+        // screen(): (x + 1) * w/2 and (1 - y) * h/2 with x, y already divided by z
+        __m256 qx = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(vx, inv), one), halfW);
+        __m256 qy = _mm256_mul_ps(_mm256_sub_ps(one, _mm256_mul_ps(vy, inv)), halfH);
+
+        _mm256_storeu_ps(sx + i, _mm256_blendv_ps(nan, qx, inFront));
+        _mm256_storeu_ps(sy + i, _mm256_blendv_ps(nan, qy, inFront));
+        _mm256_storeu_ps(depth + i, _mm256_and_ps(vz, inFront));
+        visible += laneCount(_mm256_movemask_ps(inFront));
+    }
+#elif defined(GRAVITY_SIMD_SSE)
+    const __m128 m00 = _mm_set1_ps(cam.m[0][0]), m01 = _mm_set1_ps(cam.m[0][1]), m02 = _mm_set1_ps(cam.m[0][2]);
+    const __m128 m10 = _mm_set1_ps(cam.m[1][0]), m11 = _mm_set1_ps(cam.m[1][1]), m12 = _mm_set1_ps(cam.m[1][2]);
+    const __m128 m20 = _mm_set1_ps(cam.m[2][0]), m21 = _mm_set1_ps(cam.m[2][1]), m22 = _mm_set1_ps(cam.m[2][2]);
+    const __m128 t0 = _mm_set1_ps(cam.t[0]), t1 = _mm_set1_ps(cam.t[1]), t2 = _mm_set1_ps(cam.t[2]);
+    const __m128 halfW = _mm_set1_ps(0.5f * w);
+    const __m128 halfH = _mm_set1_ps(0.5f * h);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 nearZ = _mm_set1_ps(NEAR_PLANE_THRESHOLD);
+    const __m128 nan = _mm_set1_ps(NAN);
+
+    for (; i + 4 <= n; i += 4) {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+
+        __m128 vx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m00, px), _mm_mul_ps(m01, py)),
+                               _mm_add_ps(_mm_mul_ps(m02, pz), t0));
+        __m128 vy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m10, px), _mm_mul_ps(m11, py)),
+                               _mm_add_ps(_mm_mul_ps(m12, pz), t1));
+        __m128 vz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m20, px), _mm_mul_ps(m21, py)),
+                               _mm_add_ps(_mm_mul_ps(m22, pz), t2));
+
+        __m128 inFront = _mm_cmpgt_ps(vz, nearZ);
+        __m128 inv = _mm_div_ps(one, vz);
+
+        __m128 qx = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(vx, inv), one), halfW);
+        __m128 qy = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(vy, inv)), halfH);
+
+        _mm_storeu_ps(sx + i, _mm_or_ps(_mm_and_ps(inFront, qx), _mm_andnot_ps(inFront, nan)));
+        _mm_storeu_ps(sy + i, _mm_or_ps(_mm_and_ps(inFront, qy), _mm_andnot_ps(inFront, nan)));
+        _mm_storeu_ps(depth + i, _mm_and_ps(vz, inFront));
+        visible += laneCount(_mm_movemask_ps(inFront));
+    }
+#endif
+
+    return visible + projectScalar(cam, x, y, z, i, n, w, h, sx, sy, depth);
 }
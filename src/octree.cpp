@@ -0,0 +1,326 @@
+#include "octree.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <type_traits>
+
+namespace {
+
+OctreeNode makeNode(int bodyStart, int bodyCount) {
+    OctreeNode n{};
+    n.firstChild = -1;
+    n.childCount = 0;
+    n.bodyStart = bodyStart;
+    n.bodyCount = bodyCount;
+    return n;
+}
+
+int octantOf(float x, float y, float z, float cx, float cy, float cz) {
+    return (x >= cx ? 1 : 0) | (y >= cy ? 2 : 0) | (z >= cz ? 4 : 0);
+}
+
+} // namespace
+
+void Octree::build(const BodyStore& bodies) {
+    const int n = (int)bodies.size();
+
+    nodes_.clear();
+    order_.resize(n);
+    scratch_.resize(n);
+    for (int i = 0; i < n; i++)
+        order_[i] = i;
+
+    if (n == 0)
+        return;
+
+    float minX = bodies.x[0], maxX = bodies.x[0];
+    float minY = bodies.y[0], maxY = bodies.y[0];
+    float minZ = bodies.z[0], maxZ = bodies.z[0];
+    for (int i = 1; i < n; i++) {
+        minX = std::min(minX, bodies.x[i]); maxX = std::max(maxX, bodies.x[i]);
+        minY = std::min(minY, bodies.y[i]); maxY = std::max(maxY, bodies.y[i]);
+        minZ = std::min(minZ, bodies.z[i]); maxZ = std::max(maxZ, bodies.z[i]);
+    }
+
+    float half = 0.5f * std::max({ maxX - minX, maxY - minY, maxZ - minZ });
+    half = half * 1.001f + 1e-6f;
+
+    nodes_.push_back(makeNode(0, n));
+    buildNode(bodies, 0,
+              0.5f * (minX + maxX), 0.5f * (minY + maxY), 0.5f * (minZ + maxZ),
+              half, 0);
+    computeMoments(bodies);
+}
+
+void Octree::refit(const BodyStore& bodies) {
+    if (nodes_.empty() || order_.size() != bodies.size()) {
+        build(bodies);
+        return;
+    }
+    computeMoments(bodies);
+}
+
+void Octree::buildNode(const BodyStore& bodies, int node,
+                       float cx, float cy, float cz, float half, int depth)
+{
+    const int start = nodes_[node].bodyStart;
+    const int count = nodes_[node].bodyCount;
+    if (count <= LEAF_CAPACITY || depth >= MAX_DEPTH)
+        return;
+
+    // counting sort of this node's bodies by octant
+    int counts[8] = { 0 };
+    for (int k = start; k < start + count; k++) {
+        int b = order_[k];
+        counts[octantOf(bodies.x[b], bodies.y[b], bodies.z[b], cx, cy, cz)]++;
+    }
+
+    int offsets[8];
+    int running = start;
+    for (int o = 0; o < 8; o++) {
+        offsets[o] = running;
+        running += counts[o];
+    }
+
+    int cursor[8];
+    std::copy(offsets, offsets + 8, cursor);
+    for (int k = start; k < start + count; k++) {
+        int b = order_[k];
+        scratch_[cursor[octantOf(bodies.x[b], bodies.y[b], bodies.z[b], cx, cy, cz)]++] = b;
+    }
+    std::copy(scratch_.begin() + start, scratch_.begin() + start + count,
+              order_.begin() + start);
+
+    const int first = (int)nodes_.size();
+    int octants[8];
+    int childCount = 0;
+    for (int o = 0; o < 8; o++) {
+        if (counts[o] == 0)
+            continue;
+        octants[childCount++] = o;
+        nodes_.push_back(makeNode(offsets[o], counts[o]));
+    }
+
+    nodes_[node].firstChild = first;
+    nodes_[node].childCount = childCount;
+
+    const float h = 0.5f * half;
+    for (int k = 0; k < childCount; k++) {
+        int o = octants[k];
+        buildNode(bodies, first + k,
+                  cx + ((o & 1) ? h : -h),
+                  cy + ((o & 2) ? h : -h),
+                  cz + ((o & 4) ? h : -h),
+                  h, depth + 1);
+    }
+}
+
+void Octree::computeMoments(const BodyStore& bodies) {
+    // children are always allocated after their parent, so a reverse sweep
+    // visits every node after all of its children
+    for (int idx = (int)nodes_.size() - 1; idx >= 0; idx--) {
+        OctreeNode& n = nodes_[idx];
+
+        float m = 0.0f, mx = 0.0f, my = 0.0f, mz = 0.0f;
+        float minX = INFINITY, minY = INFINITY, minZ = INFINITY;
+        float maxX = -INFINITY, maxY = -INFINITY, maxZ = -INFINITY;
+
+        if (n.firstChild < 0) {
+            for (int k = n.bodyStart; k < n.bodyStart + n.bodyCount; k++) {
+                int b = order_[k];
+                m  += bodies.mass[b];
+                mx += bodies.mass[b] * bodies.x[b];
+                my += bodies.mass[b] * bodies.y[b];
+                mz += bodies.mass[b] * bodies.z[b];
+                minX = std::min(minX, bodies.x[b]); maxX = std::max(maxX, bodies.x[b]);
+                minY = std::min(minY, bodies.y[b]); maxY = std::max(maxY, bodies.y[b]);
+                minZ = std::min(minZ, bodies.z[b]); maxZ = std::max(maxZ, bodies.z[b]);
+            }
+        } else {
+            for (int c = n.firstChild; c < n.firstChild + n.childCount; c++) {
+                const OctreeNode& ch = nodes_[c];
+                m  += ch.mass;
+                mx += ch.mass * ch.comX;
+                my += ch.mass * ch.comY;
+                mz += ch.mass * ch.comZ;
+                minX = std::min(minX, ch.minX); maxX = std::max(maxX, ch.maxX);
+                minY = std::min(minY, ch.minY); maxY = std::max(maxY, ch.maxY);
+                minZ = std::min(minZ, ch.minZ); maxZ = std::max(maxZ, ch.maxZ);
+            }
+        }
+
+        n.minX = minX; n.minY = minY; n.minZ = minZ;
+        n.maxX = maxX; n.maxY = maxY; n.maxZ = maxZ;
+        n.size = std::max({ maxX - minX, maxY - minY, maxZ - minZ });
+        n.mass = m;
+
+        if (m > 0.0f) {
+            n.comX = mx / m;
+            n.comY = my / m;
+            n.comZ = mz / m;
+        } else {
+            n.comX = 0.5f * (minX + maxX);
+            n.comY = 0.5f * (minY + maxY);
+            n.comZ = 0.5f * (minZ + maxZ);
+        }
+
+        // Q_ij = sum m (3 d_i d_j - |d|^2 delta_ij), d relative to this node's com.
+        // For children the parallel-axis term is added to their own moments.
+        float qxx = 0, qxy = 0, qxz = 0, qyy = 0, qyz = 0, qzz = 0;
+        auto addPoint = [&](float pm, float px, float py, float pz) {
+            float dx = px - n.comX, dy = py - n.comY, dz = pz - n.comZ;
+            float d2 = dx*dx + dy*dy + dz*dz;
+            qxx += pm * (3*dx*dx - d2);
+            qyy += pm * (3*dy*dy - d2);
+            qzz += pm * (3*dz*dz - d2);
+            qxy += pm * 3*dx*dy;
+            qxz += pm * 3*dx*dz;
+            qyz += pm * 3*dy*dz;
+        };
+
+        if (n.firstChild < 0) {
+            for (int k = n.bodyStart; k < n.bodyStart + n.bodyCount; k++) {
+                int b = order_[k];
+                addPoint(bodies.mass[b], bodies.x[b], bodies.y[b], bodies.z[b]);
+            }
+        } else {
+            for (int c = n.firstChild; c < n.firstChild + n.childCount; c++) {
+                const OctreeNode& ch = nodes_[c];
+                addPoint(ch.mass, ch.comX, ch.comY, ch.comZ);
+                qxx += ch.qxx; qxy += ch.qxy; qxz += ch.qxz;
+                qyy += ch.qyy; qyz += ch.qyz; qzz += ch.qzz;
+            }
+        }
+
+        n.qxx = qxx; n.qxy = qxy; n.qxz = qxz;
+        n.qyy = qyy; n.qyz = qyz; n.qzz = qzz;
+    }
+}
+
+std::uint64_t Octree::computeAccelerations(BodyStore& bodies, const GravityParams& params,
+                                           ThreadPool* pool, const ActiveList* active) const
+{
+    const std::size_t count = active ? active->size() : bodies.size();
+    if (nodes_.empty()) {
+        for (std::size_t k = 0; k < count; k++) {
+            std::size_t i = active ? (*active)[k] : k;
+            bodies.ax[i] = bodies.ay[i] = bodies.az[i] = 0.0f;
+        }
+        return 0;
+    }
+
+    const float eps2 = params.softening * params.softening;
+    const float theta2 = theta_ * theta_;
+    std::atomic<std::uint64_t> interactions{ 0 };
+
+    // Wide (mixed precision) forms separations from the double positions so
+    // close pairs far from the origin keep their offset; only the difference
+    // is narrowed to float. It is a template parameter so the single-precision
+    // traversal stays all-float.
+    auto range = [&](auto wide, std::size_t begin, std::size_t end) {
+        constexpr bool Wide = decltype(wide)::value;
+        std::uint64_t count = 0;
+        for (std::size_t k = begin; k < end; k++) {
+            const int i = (int)(active ? (*active)[k] : k);
+            const float px = bodies.x[i], py = bodies.y[i], pz = bodies.z[i];
+            const double pxd = Wide ? bodies.xd[i] : px;
+            const double pyd = Wide ? bodies.yd[i] : py;
+            const double pzd = Wide ? bodies.zd[i] : pz;
+            float ax = 0.0f, ay = 0.0f, az = 0.0f;
+
+            int stack[8 * (MAX_DEPTH + 1)];
+            int top = 0;
+            stack[top++] = 0;
+
+            while (top > 0) {
+                const OctreeNode& node = nodes_[stack[--top]];
+                if (node.mass <= 0.0f)
+                    continue;
+
+                float dx, dy, dz;
+                if constexpr (Wide) {
+                    dx = (float)(node.comX - pxd);
+                    dy = (float)(node.comY - pyd);
+                    dz = (float)(node.comZ - pzd);
+                } else {
+                    dx = node.comX - px;
+                    dy = node.comY - py;
+                    dz = node.comZ - pz;
+                }
+                float d2 = dx*dx + dy*dy + dz*dz;
+
+                bool inside = px >= node.minX && px <= node.maxX
+                           && py >= node.minY && py <= node.maxY
+                           && pz >= node.minZ && pz <= node.maxZ;
+
+                if (!inside && node.size * node.size < theta2 * d2) {
+                    float r2 = d2 + eps2;
+                    float inv = 1.0f / std::sqrt(r2);
+                    float inv2 = inv * inv;
+                    float inv3 = inv * inv2;
+                    float inv5 = inv3 * inv2;
+                    float inv7 = inv5 * inv2;
+
+                    float qdx = node.qxx*dx + node.qxy*dy + node.qxz*dz;
+                    float qdy = node.qxy*dx + node.qyy*dy + node.qyz*dz;
+                    float qdz = node.qxz*dx + node.qyz*dy + node.qzz*dz;
+                    float dqd = dx*qdx + dy*qdy + dz*qdz;
+
+                    float radial = node.mass * inv3 + 2.5f * dqd * inv7;
+                    count++;
+                    ax += radial * dx - qdx * inv5;
+                    ay += radial * dy - qdy * inv5;
+                    az += radial * dz - qdz * inv5;
+                } else if (node.firstChild < 0) {
+                    count += node.bodyCount;
+                    for (int k = node.bodyStart; k < node.bodyStart + node.bodyCount; k++) {
+                        int b = order_[k];
+                        if (b == i)
+                            continue;
+                        float bx, by, bz;
+                        if constexpr (Wide) {
+                            bx = (float)(bodies.xd[b] - pxd);
+                            by = (float)(bodies.yd[b] - pyd);
+                            bz = (float)(bodies.zd[b] - pzd);
+                        } else {
+                            bx = bodies.x[b] - px;
+                            by = bodies.y[b] - py;
+                            bz = bodies.z[b] - pz;
+                        }
+                        float r2 = bx*bx + by*by + bz*bz + eps2;
+                        if (r2 <= 0.0f)
+                            continue;
+                        float inv = 1.0f / std::sqrt(r2);
+                        float s = bodies.mass[b] * inv * inv * inv;
+                        ax += bx * s;
+                        ay += by * s;
+                        az += bz * s;
+                    }
+                } else {
+                    for (int c = node.firstChild; c < node.firstChild + node.childCount; c++)
+                        stack[top++] = c;
+                }
+            }
+
+            bodies.ax[i] = params.G * ax;
+            bodies.ay[i] = params.G * ay;
+            bodies.az[i] = params.G * az;
+        }
+        interactions.fetch_add(count);
+    };
+
+    auto run = [&](auto wide) {
+        auto chunk = [&](std::size_t begin, std::size_t end) { range(wide, begin, end); };
+        if (pool)
+            pool->parallelFor(count, 256, chunk);
+        else
+            chunk(0, count);
+    };
+    if (bodies.mixed())
+        run(std::true_type{});
+    else
+        run(std::false_type{});
+    return interactions.load();
+}
@@ -0,0 +1,377 @@
+#include "pm_solver.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+
+// cells kept free on each side of the isolated box
+constexpr int ISOLATED_MARGIN = 2;
+
+struct CicWeights {
+    int i0[3], i1[3];
+    float w0[3], w1[3];
+};
+
+CicWeights cicWeights(const float p[3], const float origin[3], float invH, int n, bool periodic) {
+    CicWeights w;
+    for (int a = 0; a < 3; a++) {
+        float u = (p[a] - origin[a]) * invH;
+        if (periodic)
+            u -= n * std::floor(u / n);
+        else
+            u = std::clamp(u, 0.0f, n - 1.001f);
+
+        int i0 = std::min((int)u, n - 1);
+        float f = u - i0;
+        w.i0[a] = i0;
+        w.i1[a] = i0 + 1 < n ? i0 + 1 : 0;
+        w.w0[a] = 1.0f - f;
+        w.w1[a] = f;
+    }
+    return w;
+}
+
+} // namespace
+
+const char* pmBoundaryName(PmBoundary boundary) {
+    switch (boundary) {
+    case PmBoundary::Periodic: return "periodic";
+    case PmBoundary::Isolated: return "isolated";
+    }
+    return "unknown";
+}
+
+void PmSolver::setGridSize(int n) {
+    int p = 8;
+    while (p < n)
+        p <<= 1;
+    if (p != n_) {
+        n_ = p;
+        greenH_ = 0.0f;
+        if (boundary_ == PmBoundary::Periodic && boxSize_ > 0.0f)
+            h_ = boxSize_ / n_;
+        else
+            boxSize_ = 0.0f;
+    }
+}
+
+void PmSolver::setBoundary(PmBoundary boundary) {
+    if (boundary != boundary_) {
+        boundary_ = boundary;
+        boxSize_ = 0.0f;
+        greenH_ = 0.0f;
+    }
+}
+
+void PmSolver::setPeriodicBox(const Vec3D& origin, float size) {
+    origin_ = origin;
+    boxSize_ = size;
+    h_ = size / n_;
+}
+
+void PmSolver::fitBox(const BodyStore& bodies) {
+    const std::size_t count = bodies.size();
+
+    if (boundary_ == PmBoundary::Periodic && boxSize_ > 0.0f)
+        return;
+
+    float lo[3] = { INFINITY, INFINITY, INFINITY };
+    float hi[3] = { -INFINITY, -INFINITY, -INFINITY };
+    const float* pos[3] = { bodies.x.data(), bodies.y.data(), bodies.z.data() };
+    for (int a = 0; a < 3; a++) {
+        for (std::size_t i = 0; i < count; i++) {
+            lo[a] = std::min(lo[a], pos[a][i]);
+            hi[a] = std::max(hi[a], pos[a][i]);
+        }
+    }
+
+    float extent = std::max({ hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] });
+    if (!(extent > 0.0f))
+        extent = 1.0f;
+    const Vec3D center = { 0.5f * (lo[0] + hi[0]), 0.5f * (lo[1] + hi[1]), 0.5f * (lo[2] + hi[2]) };
+
+    if (boundary_ == PmBoundary::Periodic) {
+        boxSize_ = 1.5f * extent;
+        h_ = boxSize_ / n_;
+        origin_ = { center.x - 0.5f * boxSize_, center.y - 0.5f * boxSize_, center.z - 0.5f * boxSize_ };
+        return;
+    }
+
+    // Only the box size enters the Green's function, so keep it while the
+    // bodies still fit and it is not much too large; the origin follows the
+    // bodies every step for free.
+    const int usable = n_ - 1 - 2 * ISOLATED_MARGIN;
+    if (boxSize_ < extent || boxSize_ > 2.0f * extent) {
+        boxSize_ = 1.25f * extent;
+        h_ = boxSize_ / usable;
+    }
+
+    const float half = 0.5f * h_ * (n_ - 1);
+    origin_ = { center.x - half, center.y - half, center.z - half };
+}
+
+void PmSolver::deposit(const BodyStore& bodies, ThreadPool* pool) {
+    const std::size_t count = bodies.size();
+    const int n = n_;
+    const bool periodic = boundary_ == PmBoundary::Periodic;
+    const float invH = 1.0f / h_;
+    const float origin[3] = { origin_.x, origin_.y, origin_.z };
+    const float* pos[3] = { bodies.x.data(), bodies.y.data(), bodies.z.data() };
+
+    auto weights = [&](std::size_t i) {
+        const float p[3] = { pos[0][i], pos[1][i], pos[2][i] };
+        return cicWeights(p, origin, invH, n, periodic);
+    };
+
+    // counting sort of bodies by x slab
+    slabStart_.assign(n + 1, 0);
+    order_.resize(count);
+    for (std::size_t i = 0; i < count; i++)
+        slabStart_[weights(i).i0[0] + 1]++;
+    for (int s = 0; s < n; s++)
+        slabStart_[s + 1] += slabStart_[s];
+
+    std::vector<std::uint32_t> cursor(slabStart_.begin(), slabStart_.end() - 1);
+    for (std::size_t i = 0; i < count; i++)
+        order_[cursor[weights(i).i0[0]]++] = (std::uint32_t)i;
+
+    std::fill(mass_.begin(), mass_.end(), 0.0f);
+
+    // A body in slab s writes slabs s and s + 1. Group g owns slabs 2g and
+    // 2g + 1, so it writes 2g .. 2g + 2; groups of equal parity never touch.
+    const std::size_t groups = n / 2;
+    for (int parity = 0; parity < 2; parity++) {
+        auto run = [&](std::size_t begin, std::size_t end) {
+            for (std::size_t k = begin; k < end; k++) {
+                const std::size_t g = 2 * k + parity;
+                for (std::uint32_t s = slabStart_[2 * g]; s < slabStart_[2 * g + 2]; s++) {
+                    const std::uint32_t i = order_[s];
+                    const CicWeights w = weights(i);
+                    const float m = bodies.mass[i];
+
+                    for (int cx = 0; cx < 2; cx++) {
+                        const int x = cx ? w.i1[0] : w.i0[0];
+                        const float wx = m * (cx ? w.w1[0] : w.w0[0]);
+                        for (int cy = 0; cy < 2; cy++) {
+                            const int y = cy ? w.i1[1] : w.i0[1];
+                            const float wxy = wx * (cy ? w.w1[1] : w.w0[1]);
+                            mass_[cell(x, y, w.i0[2])] += wxy * w.w0[2];
+                            mass_[cell(x, y, w.i1[2])] += wxy * w.w1[2];
+                        }
+                    }
+                }
+            }
+        };
+
+        if (pool)
+            pool->parallelFor(groups / 2, 1, run);
+        else
+            run(0, groups / 2);
+    }
+}
+
+void PmSolver::solvePeriodic(const GravityParams& params, ThreadPool* pool) {
+    const int n = n_;
+    fft_.resize(n);
+    std::complex<float>* data = fft_.data();
+
+    const float invVolume = 1.0f / (h_ * h_ * h_);
+    for (std::size_t c = 0; c < mass_.size(); c++)
+        data[c] = mass_[c] * invVolume;
+
+    fft_.forward(pool);
+
+    // phi_k = -4 pi G rho_k / k^2, mean density removed
+    const float k0 = 2.0f * PI / (h_ * n);
+    auto scale = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t x = begin; x < end; x++) {
+            float kx = k0 * (x < (std::size_t)n / 2 ? (float)x : (float)x - n);
+            for (int y = 0; y < n; y++) {
+                float ky = k0 * (y < n / 2 ? y : y - n);
+                for (int z = 0; z < n; z++) {
+                    float kz = k0 * (z < n / 2 ? z : z - n);
+                    float k2 = kx*kx + ky*ky + kz*kz;
+                    std::size_t c = cell((int)x, y, z);
+                    data[c] = k2 > 0.0f ? data[c] * (-4.0f * PI * params.G / k2) : 0.0f;
+                }
+            }
+        }
+    };
+    if (pool)
+        pool->parallelFor(n, 1, scale);
+    else
+        scale(0, n);
+
+    fft_.inverse(pool);
+    for (std::size_t c = 0; c < phi_.size(); c++)
+        phi_[c] = data[c].real();
+}
+
+void PmSolver::solveIsolated(const GravityParams& params, ThreadPool* pool) {
+    const int n = n_;
+    const int m = 2 * n;
+    fft_.resize(m);
+    std::complex<float>* data = fft_.data();
+    auto padded = [m](int x, int y, int z) { return ((std::size_t)x * m + y) * m + z; };
+
+    // Hockney-Eastwood: convolve with the softened point-mass potential on a
+    // grid twice as large so the periodic images never overlap
+    const float eps = std::max(params.softening, 1e-3f * h_);
+    if (h_ != greenH_ || eps != greenEps_ || green_.size() != fft_.count()) {
+        for (int x = 0; x < m; x++) {
+            float dx = h_ * (x < n ? x : x - m);
+            for (int y = 0; y < m; y++) {
+                float dy = h_ * (y < n ? y : y - m);
+                for (int z = 0; z < m; z++) {
+                    float dz = h_ * (z < n ? z : z - m);
+                    data[padded(x, y, z)] = -1.0f / std::sqrt(dx*dx + dy*dy + dz*dz + eps*eps);
+                }
+            }
+        }
+        fft_.forward(pool);
+        green_.assign(data, data + fft_.count());
+        greenH_ = h_;
+        greenEps_ = eps;
+    }
+
+    std::fill(data, data + fft_.count(), std::complex<float>(0.0f, 0.0f));
+    for (int x = 0; x < n; x++)
+        for (int y = 0; y < n; y++)
+            for (int z = 0; z < n; z++)
+                data[padded(x, y, z)] = mass_[cell(x, y, z)];
+
+    fft_.forward(pool);
+
+    const std::size_t total = fft_.count();
+    auto multiply = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t c = begin; c < end; c++)
+            data[c] *= green_[c];
+    };
+    if (pool)
+        pool->parallelFor(total, 1 << 16, multiply);
+    else
+        multiply(0, total);
+
+    fft_.inverse(pool);
+
+    for (int x = 0; x < n; x++)
+        for (int y = 0; y < n; y++)
+            for (int z = 0; z < n; z++)
+                phi_[cell(x, y, z)] = params.G * data[padded(x, y, z)].real();
+}
+
+void PmSolver::differentiate(ThreadPool* pool) {
+    const int n = n_;
+    const bool periodic = boundary_ == PmBoundary::Periodic;
+
+    // central differences; one-sided at the edges of an isolated box
+    auto neighbours = [&](int i, int& lo, int& hi, float& span) {
+        if (periodic) {
+            lo = (i + n - 1) % n;
+            hi = (i + 1) % n;
+            span = 2.0f * h_;
+            return;
+        }
+        lo = std::max(i - 1, 0);
+        hi = std::min(i + 1, n - 1);
+        span = (hi - lo) * h_;
+    };
+
+    auto run = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t xs = begin; xs < end; xs++) {
+            const int x = (int)xs;
+            int x0, x1; float sx;
+            neighbours(x, x0, x1, sx);
+            for (int y = 0; y < n; y++) {
+                int y0, y1; float sy;
+                neighbours(y, y0, y1, sy);
+                for (int z = 0; z < n; z++) {
+                    int z0, z1; float sz;
+                    neighbours(z, z0, z1, sz);
+                    std::size_t c = cell(x, y, z);
+                    fx_[c] = -(phi_[cell(x1, y, z)] - phi_[cell(x0, y, z)]) / sx;
+                    fy_[c] = -(phi_[cell(x, y1, z)] - phi_[cell(x, y0, z)]) / sy;
+                    fz_[c] = -(phi_[cell(x, y, z1)] - phi_[cell(x, y, z0)]) / sz;
+                }
+            }
+        }
+    };
+    if (pool)
+        pool->parallelFor(n, 1, run);
+    else
+        run(0, n);
+}
+
+void PmSolver::interpolate(BodyStore& bodies, const ActiveList* active, ThreadPool* pool) const {
+    const int n = n_;
+    const bool periodic = boundary_ == PmBoundary::Periodic;
+    const float invH = 1.0f / h_;
+    const float origin[3] = { origin_.x, origin_.y, origin_.z };
+    const std::size_t count = active ? active->size() : bodies.size();
+
+    auto run = [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; k++) {
+            const std::size_t i = active ? (*active)[k] : k;
+            const float p[3] = { bodies.x[i], bodies.y[i], bodies.z[i] };
+
+            const CicWeights w = cicWeights(p, origin, invH, n, periodic);
+
+            float ax = 0.0f, ay = 0.0f, az = 0.0f;
+            for (int cx = 0; cx < 2; cx++) {
+                const int x = cx ? w.i1[0] : w.i0[0];
+                const float wx = cx ? w.w1[0] : w.w0[0];
+                for (int cy = 0; cy < 2; cy++) {
+                    const int y = cy ? w.i1[1] : w.i0[1];
+                    const float wxy = wx * (cy ? w.w1[1] : w.w0[1]);
+                    for (int cz = 0; cz < 2; cz++) {
+                        const int z = cz ? w.i1[2] : w.i0[2];
+                        const float wt = wxy * (cz ? w.w1[2] : w.w0[2]);
+                        const std::size_t c = cell(x, y, z);
+                        ax += wt * fx_[c];
+                        ay += wt * fy_[c];
+                        az += wt * fz_[c];
+                    }
+                }
+            }
+
+            bodies.ax[i] = ax;
+            bodies.ay[i] = ay;
+            bodies.az[i] = az;
+        }
+    };
+
+    if (pool)
+        pool->parallelFor(count, 1024, run);
+    else
+        run(0, count);
+}
+
+std::uint64_t PmSolver::computeAccelerations(BodyStore& bodies, const GravityParams& params,
+                                             ThreadPool* pool, const ActiveList* active)
+{
+    if (bodies.empty())
+        return 0;
+
+    const std::size_t cells = (std::size_t)n_ * n_ * n_;
+    mass_.resize(cells);
+    phi_.resize(cells);
+    fx_.resize(cells);
+    fy_.resize(cells);
+    fz_.resize(cells);
+
+    fitBox(bodies);
+    deposit(bodies, pool);
+
+    if (boundary_ == PmBoundary::Periodic)
+        solvePeriodic(params, pool);
+    else
+        solveIsolated(params, pool);
+
+    differentiate(pool);
+    interpolate(bodies, active, pool);
+    return active ? active->size() : bodies.size();
+}
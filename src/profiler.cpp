@@ -0,0 +1,164 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+constexpr double MIN_BUCKET_MS = 1e-3;
+
+std::uint32_t currentThreadIndex() {
+    static std::atomic<std::uint32_t> nextIndex{ 0 };
+    thread_local std::uint32_t index = nextIndex.fetch_add(1);
+    return index;
+}
+
+} // namespace
+
+PhaseHistogram::PhaseHistogram(std::size_t window)
+    : window_(std::max<std::size_t>(window, 1))
+{
+}
+
+void PhaseHistogram::add(double ms) {
+    int bucket = 0;
+    if (ms >= MIN_BUCKET_MS) {
+        bucket = 1 + (int)std::floor(std::log2(ms / MIN_BUCKET_MS) * BUCKETS_PER_OCTAVE);
+        bucket = std::min(bucket, BUCKETS - 1);
+    }
+
+    if (full_)
+        counts_[window_[next_]]--;
+    window_[next_] = (std::uint16_t)bucket;
+    counts_[bucket]++;
+
+    if (++next_ == window_.size()) {
+        next_ = 0;
+        full_ = true;
+    }
+    last_ = ms;
+}
+
+double PhaseHistogram::percentile(double p) const {
+    const std::size_t n = count();
+    if (n == 0)
+        return 0.0;
+
+    std::size_t target = (std::size_t)std::ceil(std::clamp(p, 0.0, 1.0) * n);
+    target = std::max<std::size_t>(target, 1);
+
+    std::size_t seen = 0;
+    int bucket = 0;
+    for (; bucket < BUCKETS - 1; bucket++) {
+        seen += counts_[bucket];
+        if (seen >= target)
+            break;
+    }
+
+    if (bucket == 0)
+        return 0.5 * MIN_BUCKET_MS;
+    // geometric centre of [2^((b-1)/8), 2^(b/8)) us
+    return MIN_BUCKET_MS * std::exp2((bucket - 0.5) / BUCKETS_PER_OCTAVE);
+}
+
+Profiler& Profiler::instance() {
+    static Profiler profiler;
+    return profiler;
+}
+
+Profiler::Profiler()
+    : epoch_(Clock::now())
+{
+}
+
+void Profiler::record(const char* name, Clock::time_point start, Clock::time_point end) {
+    const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+    const std::uint32_t thread = currentThreadIndex();
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    auto it = std::find_if(phases_.begin(), phases_.end(),
+                           [name](const Phase& p) {
+                               return p.name == name || std::strcmp(p.name, name) == 0;
+                           });
+    if (it == phases_.end()) {
+        phases_.push_back({ name, PhaseHistogram() });
+        it = phases_.end() - 1;
+    }
+    it->histogram.add(ms);
+
+    if (tracing_) {
+        if (events_.size() < maxEvents_) {
+            double startUs = std::chrono::duration<double, std::micro>(start - epoch_).count();
+            events_.push_back({ name, thread, startUs, ms * 1000.0 });
+        } else {
+            dropped_++;
+        }
+    }
+}
+
+void Profiler::setThreadName(const char* name) {
+    const std::uint32_t thread = currentThreadIndex();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : threadNames_) {
+        if (entry.first == thread) {
+            entry.second = name;
+            return;
+        }
+    }
+    threadNames_.emplace_back(thread, name);
+}
+
+std::vector<PhaseSummary> Profiler::summary() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<PhaseSummary> out;
+    out.reserve(phases_.size());
+    for (const Phase& p : phases_) {
+        out.push_back({ p.name, p.histogram.count(), p.histogram.last(),
+                        p.histogram.percentile(0.50), p.histogram.percentile(0.99) });
+    }
+    return out;
+}
+
+void Profiler::setTracing(bool enabled, std::size_t maxEvents) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tracing_ = enabled;
+    maxEvents_ = maxEvents;
+    if (enabled)
+        events_.reserve(std::min<std::size_t>(maxEvents, 1u << 16));
+}
+
+std::size_t Profiler::traceEventsDropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const {
+    std::FILE* f = std::fopen(path.c_str(), "w");
+    if (!f)
+        return false;
+
+    // names are string literals from PROFILE_SCOPE, so no JSON escaping
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    for (const auto& entry : threadNames_) {
+        std::fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                        "\"args\":{\"name\":\"%s\"}}",
+                     first ? "" : ",\n", entry.first, entry.second.c_str());
+        first = false;
+    }
+    for (const TraceEvent& e : events_) {
+        std::fprintf(f, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                        "\"ts\":%.3f,\"dur\":%.3f}",
+                     first ? "" : ",\n", e.name, e.thread, e.startUs, e.durationUs);
+        first = false;
+    }
+
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
@@ -0,0 +1,148 @@
+#include "renderer.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+constexpr int ATLAS_PADDING = 2;
+constexpr float LIGHT_QUANTUM = 1.0f / 128.0f;
+constexpr float MIN_RADIUS_PX = 1.0f;
+
+} // namespace
+
+SphereAtlas::SphereAtlas() {
+    int width = 0;
+    for (int k = 0; k < SIZE_COUNT; k++) {
+        offsets_[k] = width;
+        width += SIZES[k] + ATLAS_PADDING;
+    }
+    const int height = SIZES[SIZE_COUNT - 1];
+
+    image_ = sf::Image(sf::Vector2u((unsigned)width, (unsigned)height), sf::Color::Transparent);
+    if (!texture_.resize(image_.getSize()))
+        return;
+    texture_.setSmooth(true);
+}
+
+bool SphereAtlas::update(const Vec3D& lightDirView) {
+    std::int32_t key[3] = {
+        (std::int32_t)std::lround(lightDirView.x / LIGHT_QUANTUM),
+        (std::int32_t)std::lround(lightDirView.y / LIGHT_QUANTUM),
+        (std::int32_t)std::lround(lightDirView.z / LIGHT_QUANTUM)
+    };
+    if (std::equal(key, key + 3, lightKey_))
+        return false;
+
+    std::copy(key, key + 3, lightKey_);
+    shade(lightDirView);
+    return true;
+}
+
+void SphereAtlas::shade(const Vec3D& lightDirView) {
+    for (int k = 0; k < SIZE_COUNT; k++) {
+        const int d = SIZES[k];
+        const float r = 0.5f * d;
+
+        for (int y = 0; y < d; y++) {
+            for (int x = 0; x < d; x++) {
+                // sample at texel centers so the sprite is symmetric
+                float nx = (x + 0.5f - r) / r;
+                float ny = (y + 0.5f - r) / r;
+
+                sf::Vector2u px{ (unsigned)(offsets_[k] + x), (unsigned)y };
+
+                float d2 = nx*nx + ny*ny;
+                if (d2 > 1.0f) {
+                    image_.setPixel(px, sf::Color::Transparent);
+                    continue;
+                }
+
+                float nz = std::sqrt(1.0f - d2);
+                float lambert = std::max(0.15f, dot({ nx, ny, nz }, lightDirView));
+
+                uint8_t c = static_cast<uint8_t>(lambert * 255);
+                image_.setPixel(px, sf::Color(c, c, c));
+            }
+        }
+    }
+
+    texture_.update(image_);
+}
+
+void SphereAtlas::spriteFor(float radiusPx, float& left, float& size) const {
+    const float diameter = 2.0f * radiusPx;
+    int k = 0;
+    while (k < SIZE_COUNT - 1 && SIZES[k] < diameter)
+        k++;
+    left = (float)offsets_[k];
+    size = (float)SIZES[k];
+}
+
+void BodyRenderer::draw(sf::RenderTarget& target, const BodyView& bodies,
+                        const CameraMatrix& camera, const Vec3D& lightDirView)
+{
+    atlas_.update(lightDirView);
+
+    const sf::Vector2u size = target.getSize();
+    const int W = (int)size.x;
+    const int H = (int)size.y;
+    const std::size_t n = bodies.count;
+
+    {
+        PROFILE_SCOPE("transform");
+        sx_.resize(n);
+        sy_.resize(n);
+        depth_.resize(n);
+        projectToScreen(camera, bodies.x, bodies.y, bodies.z, n,
+                        W, H, sx_.data(), sy_.data(), depth_.data());
+
+        visible_.clear();
+        for (std::size_t i = 0; i < n; i++) {
+            if (depth_[i] <= NEAR_PLANE_THRESHOLD)
+                continue;
+
+            float x = sx_[i], y = sy_[i];
+            float r = std::max(MIN_RADIUS_PX, bodies.radius[i] / depth_[i] * W);
+
+            if (x + r < 0 || x - r > W || y + r < 0 || y - r > H)
+                continue;
+
+            visible_.push_back({ depth_[i], x, y, r });
+        }
+    }
+
+    PROFILE_SCOPE("rasterize");
+
+    // painter's order: farthest first
+    std::sort(visible_.begin(), visible_.end(),
+              [](const Visible& a, const Visible& b) { return a.depth > b.depth; });
+
+    vertices_.resize(visible_.size() * 6);
+    for (std::size_t k = 0; k < visible_.size(); k++) {
+        const Visible& v = visible_[k];
+
+        float left, texSize;
+        atlas_.spriteFor(v.r, left, texSize);
+
+        sf::Vector2f p0{ v.x - v.r, v.y - v.r };
+        sf::Vector2f p1{ v.x + v.r, v.y + v.r };
+        sf::Vector2f t0{ left, 0.0f };
+        sf::Vector2f t1{ left + texSize, texSize };
+
+        sf::Vertex* q = &vertices_[k * 6];
+        q[0].position = p0;                 q[0].texCoords = t0;
+        q[1].position = { p1.x, p0.y };     q[1].texCoords = { t1.x, t0.y };
+        q[2].position = p1;                 q[2].texCoords = t1;
+        q[3].position = p0;                 q[3].texCoords = t0;
+        q[4].position = p1;                 q[4].texCoords = t1;
+        q[5].position = { p0.x, p1.y };     q[5].texCoords = { t0.x, t1.y };
+        for (int c = 0; c < 6; c++)
+            q[c].color = sf::Color::White;
+    }
+
+    sf::RenderStates states;
+    states.texture = &atlas_.texture();
+    target.draw(vertices_, states);
+}
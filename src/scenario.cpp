@@ -0,0 +1,102 @@
+#include "scenario.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+
+namespace {
+
+constexpr float PI = 3.14159265358979f;
+
+} // namespace
+
+void makeStarSystem(BodyStore& bodies, const GravityParams& gravity) {
+    const float starMass = 10.0f;
+    bodies.add({ { 0, 0, 0 }, { 0, 0, 0 }, starMass, 0.5f });
+
+    for (int k = 0; k < 4; k++) {
+        float r = 1.5f + 1.0f * k;
+        float a = k * 1.7f;
+        float v = std::sqrt(gravity.G * starMass / r);
+        bodies.add({
+            { r * std::cos(a), 0, r * std::sin(a) },
+            { -v * std::sin(a), 0, v * std::cos(a) },
+            0.01f,
+            0.1f + 0.05f * k
+        });
+    }
+}
+
+void makeDisk(BodyStore& bodies, std::size_t n, unsigned seed, const GravityParams& gravity) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> thickness(0.0f, 0.02f);
+
+    const float centralMass = 1.0f;
+    const float diskMass = 0.01f;
+    const float rMin = 0.5f, rMax = 3.0f;
+
+    bodies.reserve(bodies.size() + n + 1);
+    bodies.add({ { 0, 0, 0 }, { 0, 0, 0 }, centralMass, 0.1f });
+
+    const float m = n > 0 ? diskMass / n : 0.0f;
+    for (std::size_t i = 0; i < n; i++) {
+        // uniform in area between rMin and rMax
+        float r = std::sqrt(rMin*rMin + unit(rng) * (rMax*rMax - rMin*rMin));
+        float a = 2.0f * PI * unit(rng);
+
+        float enclosed = centralMass + diskMass * (r*r - rMin*rMin) / (rMax*rMax - rMin*rMin);
+        float v = std::sqrt(gravity.G * enclosed / r);
+
+        bodies.add({
+            { r * std::cos(a), thickness(rng) * r, r * std::sin(a) },
+            { -v * std::sin(a), 0, v * std::cos(a) },
+            m,
+            0.01f
+        });
+    }
+}
+
+void makePlummer(BodyStore& bodies, std::size_t n, unsigned seed, const GravityParams& gravity) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    // Aarseth, Henon & Wielen (1974) sampling in N-body units (G = M = 1,
+    // E = -1/4), with lengths and velocities rescaled for gravity.G
+    const float lengthScale = 3.0f * PI / 16.0f;
+    const float velocityScale = std::sqrt(gravity.G / lengthScale);
+
+    auto isotropic = [&](float radius, float& x, float& y, float& z) {
+        float cz = 1.0f - 2.0f * unit(rng);
+        float sz = std::sqrt(std::max(0.0f, 1.0f - cz * cz));
+        float phi = 2.0f * PI * unit(rng);
+        x = radius * sz * std::cos(phi);
+        y = radius * sz * std::sin(phi);
+        z = radius * cz;
+    };
+
+    bodies.reserve(bodies.size() + n);
+    const float m = n > 0 ? 1.0f / n : 0.0f;
+    for (std::size_t i = 0; i < n; i++) {
+        float r;
+        do {
+            float u = std::max(unit(rng), 1e-6f);
+            r = 1.0f / std::sqrt(std::pow(u, -2.0f / 3.0f) - 1.0f);
+        } while (r > 10.0f);
+
+        // von Neumann rejection for q = v / v_escape
+        float q, g;
+        do {
+            q = unit(rng);
+            g = 0.1f * unit(rng);
+        } while (g > q * q * std::pow(1.0f - q * q, 3.5f));
+        float v = q * std::sqrt(2.0f) * std::pow(1.0f + r * r, -0.25f);
+
+        Body b{};
+        isotropic(r * lengthScale, b.position.x, b.position.y, b.position.z);
+        isotropic(v * velocityScale, b.velocity.x, b.velocity.y, b.velocity.z);
+        b.mass = m;
+        b.radius = 0.01f;
+        bodies.add(b);
+    }
+}
@@ -0,0 +1,115 @@
+#include "sim_thread.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+void BodySnapshot::capture(const BodyStore& bodies, std::uint64_t atStep, double atTime) {
+    step = atStep;
+    time = atTime;
+    x.assign(bodies.x.begin(), bodies.x.end());
+    y.assign(bodies.y.begin(), bodies.y.end());
+    z.assign(bodies.z.begin(), bodies.z.end());
+    radius.assign(bodies.radius.begin(), bodies.radius.end());
+}
+
+SimulationThread::SimulationThread(Simulation& sim, float fixedDt)
+    : sim_(sim)
+{
+    fixed_.dt = fixedDt;
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (running_.load())
+        return;
+
+    // give the renderer a state to show before the first step lands
+    publish();
+
+    running_.store(true);
+    thread_ = std::thread([this] { run(); });
+}
+
+void SimulationThread::stop() {
+    running_.store(false);
+    if (thread_.joinable())
+        thread_.join();
+}
+
+void SimulationThread::publish() {
+    PROFILE_SCOPE("publish");
+    snapshots_.writeBuffer().capture(sim_.bodies(), sim_.stepCount(), sim_.time());
+    snapshots_.publish();
+}
+
+void SimulationThread::run() {
+    using Clock = std::chrono::steady_clock;
+    auto last = Clock::now();
+    Profiler::instance().setThreadName("simulation");
+
+    while (running_.load()) {
+        int solver = solverRequest_.exchange(-1);
+        if (solver >= 0)
+            sim_.setSolver((Solver)solver);
+
+        float theta = thetaRequest_.exchange(-1.0f);
+        if (theta >= 0.0f)
+            sim_.tree().setTheta(theta);
+
+        auto now = Clock::now();
+        float elapsed = std::chrono::duration<float>(now - last).count();
+        last = now;
+
+        int steps = fixed_.consume(elapsed);
+        for (int s = 0; s < steps; s++)
+            sim_.step(fixed_.dt);
+
+        if (steps > 0) {
+            publish();
+            if (recorder_) {
+                PROFILE_SCOPE("record");
+                recorder_->submit(sim_.bodies(), sim_.stepCount(), sim_.time());
+            }
+        } else {
+            // nothing due yet: sleep until the next step is
+            std::this_thread::sleep_for(std::chrono::duration<float>(fixed_.dt - fixed_.accumulator));
+        }
+    }
+}
+
+void StateInterpolator::push(const BodySnapshot& snapshot, double wallTime) {
+    std::swap(prev_, curr_);
+    prevTime_ = currTime_;
+    hasPrev_ = pushes_ > 0;
+    pushes_++;
+
+    curr_.step = snapshot.step;
+    curr_.time = snapshot.time;
+    curr_.x.assign(snapshot.x.begin(), snapshot.x.end());
+    curr_.y.assign(snapshot.y.begin(), snapshot.y.end());
+    curr_.z.assign(snapshot.z.begin(), snapshot.z.end());
+    curr_.radius.assign(snapshot.radius.begin(), snapshot.radius.end());
+    currTime_ = wallTime;
+}
+
+BodyView StateInterpolator::at(double wallTime) {
+    const std::size_t n = curr_.x.size();
+    if (!hasPrev_ || prev_.x.size() != n || currTime_ <= prevTime_)
+        return curr_.view();
+
+    const float alpha = (float)std::clamp((wallTime - currTime_) / (currTime_ - prevTime_), 0.0, 1.0);
+
+    x_.resize(n);
+    y_.resize(n);
+    z_.resize(n);
+    for (std::size_t i = 0; i < n; i++) {
+        x_[i] = prev_.x[i] + (curr_.x[i] - prev_.x[i]) * alpha;
+        y_[i] = prev_.y[i] + (curr_.y[i] - prev_.y[i]) * alpha;
+        z_[i] = prev_.z[i] + (curr_.z[i] - prev_.z[i]) * alpha;
+    }
+    return { x_.data(), y_.data(), z_.data(), curr_.radius.data(), n };
+}
@@ -0,0 +1,300 @@
+#include "simulation.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+constexpr std::size_t INTEGRATE_GRAIN = 4096;
+constexpr std::size_t ENERGY_GRAIN = 256;
+
+using Clock = std::chrono::steady_clock;
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+} // namespace
+
+Simulation::Simulation(unsigned threads)
+    : pool_(threads)
+{
+}
+
+void Simulation::computeForces(const ActiveList* active, bool refit) {
+    const std::uint64_t n = bodies_.size();
+    const std::uint64_t count = active ? active->size() : n;
+
+    if (solver_ == Solver::BarnesHut) {
+        auto start = Clock::now();
+        {
+            PROFILE_SCOPE("tree");
+            if (refit)
+                tree_.refit(bodies_);
+            else
+                tree_.build(bodies_);
+        }
+        timings_.tree += secondsSince(start);
+
+        start = Clock::now();
+        PROFILE_SCOPE("force");
+        interactions_ += tree_.computeAccelerations(bodies_, gravity_, &pool_, active);
+        timings_.force += secondsSince(start);
+    } else if (solver_ == Solver::ParticleMesh) {
+        PROFILE_SCOPE("force");
+        auto start = Clock::now();
+        interactions_ += pm_.computeAccelerations(bodies_, gravity_, &pool_, active);
+        timings_.force += secondsSince(start);
+    } else {
+        PROFILE_SCOPE("force");
+        auto start = Clock::now();
+        computeAccelerationsDirect(bodies_, gravity_, &pool_, active);
+        timings_.force += secondsSince(start);
+        interactions_ += n > 0 ? count * (n - 1) : 0;
+    }
+
+    forceEvaluations_ += count;
+}
+
+void Simulation::kick(float dt) {
+    PROFILE_SCOPE("integrate");
+    auto start = Clock::now();
+    BodyStore& b = bodies_;
+    pool_.parallelFor(b.size(), INTEGRATE_GRAIN, [&](std::size_t begin, std::size_t end) {
+        if (b.mixed()) {
+            for (std::size_t i = begin; i < end; i++) {
+                b.vxd[i] += (double)b.ax[i] * dt;
+                b.vyd[i] += (double)b.ay[i] * dt;
+                b.vzd[i] += (double)b.az[i] * dt;
+                b.syncFloat(i);
+            }
+            return;
+        }
+        for (std::size_t i = begin; i < end; i++) {
+            b.vx[i] += b.ax[i] * dt;
+            b.vy[i] += b.ay[i] * dt;
+            b.vz[i] += b.az[i] * dt;
+        }
+    });
+    timings_.integrate += secondsSince(start);
+}
+
+void Simulation::kickBlock(float dtMax, const ActiveList& active) {
+    PROFILE_SCOPE("integrate");
+    auto start = Clock::now();
+    BodyStore& b = bodies_;
+    pool_.parallelFor(active.size(), INTEGRATE_GRAIN, [&](std::size_t begin, std::size_t end) {
+        for (std::size_t k = begin; k < end; k++) {
+            std::uint32_t i = active[k];
+            float h = dtMax / float(1u << b.level[i]);
+            if (b.mixed()) {
+                b.vxd[i] += (double)b.ax[i] * h;
+                b.vyd[i] += (double)b.ay[i] * h;
+                b.vzd[i] += (double)b.az[i] * h;
+                b.syncFloat(i);
+                continue;
+            }
+            b.vx[i] += b.ax[i] * h;
+            b.vy[i] += b.ay[i] * h;
+            b.vz[i] += b.az[i] * h;
+        }
+    });
+    timings_.integrate += secondsSince(start);
+}
+
+void Simulation::drift(float dt) {
+    PROFILE_SCOPE("integrate");
+    auto start = Clock::now();
+    BodyStore& b = bodies_;
+    pool_.parallelFor(b.size(), INTEGRATE_GRAIN, [&](std::size_t begin, std::size_t end) {
+        if (b.mixed()) {
+            for (std::size_t i = begin; i < end; i++) {
+                b.xd[i] += b.vxd[i] * dt;
+                b.yd[i] += b.vyd[i] * dt;
+                b.zd[i] += b.vzd[i] * dt;
+                b.syncFloat(i);
+            }
+            return;
+        }
+        for (std::size_t i = begin; i < end; i++) {
+            b.x[i] += b.vx[i] * dt;
+            b.y[i] += b.vy[i] * dt;
+            b.z[i] += b.vz[i] * dt;
+        }
+    });
+    timings_.integrate += secondsSince(start);
+}
+
+void Simulation::step(float dt) {
+    PROFILE_SCOPE("step");
+    timings_ = StepTimings{};
+    interactions_ = 0;
+    forceEvaluations_ = 0;
+    merges_ = 0;
+
+    if (blocks_.enabled) {
+        stepBlock(dt);
+    } else {
+        if (!forcesValid_) {
+            computeForces();
+            forcesValid_ = true;
+        }
+
+        if (integrator_ == Integrator::Yoshida4)
+            stepYoshida(dt);
+        else
+            stepLeapfrog(dt);
+    }
+
+    if (collisions_) {
+        PROFILE_SCOPE("collide");
+        auto start = Clock::now();
+        merges_ = collider_.resolve(bodies_);
+        if (merges_ > 0)
+            forcesValid_ = false;
+        timings_.collide = secondsSince(start);
+    }
+
+    time_ += dt;
+    stepCount_++;
+}
+
+void Simulation::stepLeapfrog(float dt) {
+    // accelerations from the end of the previous step are still valid here
+    kick(0.5f * dt);
+    drift(dt);
+    computeForces();
+    kick(0.5f * dt);
+}
+
+void Simulation::stepYoshida(float dt) {
+    // Yoshida (1990) triple-jump composition of kick-drift-kick leapfrog
+    const double cbrt2 = std::cbrt(2.0);
+    const float w1 = float(1.0 / (2.0 - cbrt2));
+    const float w0 = float(-cbrt2 / (2.0 - cbrt2));
+
+    stepLeapfrog(w1 * dt);
+    stepLeapfrog(w0 * dt);
+    stepLeapfrog(w1 * dt);
+}
+
+int Simulation::levelFor(std::size_t i, float dtMax) const {
+    const BodyStore& b = bodies_;
+    float a = std::sqrt(b.ax[i] * b.ax[i] + b.ay[i] * b.ay[i] + b.az[i] * b.az[i]);
+    if (a <= 0.0f)
+        return 0;
+
+    float dt = blocks_.eta * std::sqrt(gravity_.softening / a);
+    if (dt >= dtMax)
+        return 0;
+
+    int level = (int)std::ceil(std::log2(dtMax / dt));
+    return std::clamp(level, 0, blocks_.clampedMaxLevel());
+}
+
+void Simulation::stepBlock(float dtMax) {
+    BodyStore& b = bodies_;
+    const std::size_t n = b.size();
+    if (n == 0)
+        return;
+    const int maxLevel = blocks_.clampedMaxLevel();
+    const std::uint32_t ticks = 1u << maxLevel;
+    const float dtMin = dtMax / ticks;
+
+    auto ticksFor = [&](int level) { return 1u << (maxLevel - level); };
+
+    if (!forcesValid_) {
+        computeForces();
+        for (std::size_t i = 0; i < n; i++)
+            b.level[i] = (std::uint8_t)levelFor(i, dtMax);
+        forcesValid_ = true;
+    }
+
+    // every body starts its step at the beginning of the block
+    active_.resize(n);
+    for (std::size_t i = 0; i < n; i++)
+        active_[i] = (std::uint32_t)i;
+
+    // jump from one sync point to the next instead of walking every tick,
+    // so empty fine levels cost nothing
+    std::uint32_t tick = 0;
+    while (tick < ticks) {
+        // opening half kick for bodies whose own step starts now
+        kickBlock(0.5f * dtMax, active_);
+
+        std::uint32_t next = ticks;
+        for (std::size_t i = 0; i < n; i++) {
+            const std::uint32_t span = ticksFor(b.level[i]);
+            next = std::min(next, (tick / span + 1) * span);
+        }
+
+        drift(dtMin * float(next - tick));
+
+        // bodies whose step ends at the next sync point get fresh forces, a
+        // closing half kick and a new bin
+        active_.clear();
+        for (std::size_t i = 0; i < n; i++) {
+            if (next % ticksFor(b.level[i]) == 0)
+                active_.push_back((std::uint32_t)i);
+        }
+
+        // the tree topology is rebuilt once per block step and refitted on
+        // the substeps in between
+        computeForces(&active_, next != ticks);
+        kickBlock(0.5f * dtMax, active_);
+
+        for (std::uint32_t i : active_) {
+            // a body may only move to a coarser bin if the new step lines up
+            // with the block boundary it is on
+            int level = levelFor(i, dtMax);
+            while (level < b.level[i] && next % ticksFor(level) != 0)
+                level++;
+            b.level[i] = (std::uint8_t)level;
+        }
+
+        tick = next;
+    }
+}
+
+double Simulation::kineticEnergy() {
+    const BodyStore& b = bodies_;
+    const bool mixed = b.mixed();
+    return pool_.parallelReduce(b.size(), INTEGRATE_GRAIN, 0.0,
+        [&](std::size_t begin, std::size_t end) {
+            double e = 0.0;
+            for (std::size_t i = begin; i < end; i++) {
+                double vx = mixed ? b.vxd[i] : b.vx[i];
+                double vy = mixed ? b.vyd[i] : b.vy[i];
+                double vz = mixed ? b.vzd[i] : b.vz[i];
+                double v2 = vx*vx + vy*vy + vz*vz;
+                e += 0.5 * b.mass[i] * v2;
+            }
+            return e;
+        },
+        [](double a, double c) { return a + c; });
+}
+
+double Simulation::potentialEnergy() {
+    const BodyStore& b = bodies_;
+    const double eps2 = (double)gravity_.softening * gravity_.softening;
+    const std::size_t n = b.size();
+    const bool mixed = b.mixed();
+
+    double sum = pool_.parallelReduce(n, ENERGY_GRAIN, 0.0,
+        [&](std::size_t begin, std::size_t end) {
+            double e = 0.0;
+            for (std::size_t i = begin; i < end; i++) {
+                for (std::size_t j = i + 1; j < n; j++) {
+                    double dx = mixed ? b.xd[j] - b.xd[i] : (double)b.x[j] - b.x[i];
+                    double dy = mixed ? b.yd[j] - b.yd[i] : (double)b.y[j] - b.y[i];
+                    double dz = mixed ? b.zd[j] - b.zd[i] : (double)b.z[j] - b.z[i];
+                    e -= (double)b.mass[i] * b.mass[j] / std::sqrt(dx*dx + dy*dy + dz*dz + eps2);
+                }
+            }
+            return e;
+        },
+        [](double a, double c) { return a + c; });
+    return gravity_.G * sum;
+}
@@ -0,0 +1,358 @@
+#include "snapshot.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if !defined(_WIN32)
+#include <sys/types.h>
+#endif
+
+namespace {
+
+constexpr char FILE_MAGIC[8] = { 'G', 'R', 'A', 'V', 'S', 'N', 'A', 'P' };
+constexpr char FOOTER_MAGIC[8] = { 'G', 'R', 'A', 'V', 'I', 'N', 'D', 'X' };
+
+std::size_t pad8(std::size_t n) {
+    return (n + 7) & ~std::size_t(7);
+}
+
+std::size_t positionBytes(PositionEncoding encoding, std::size_t n) {
+    return encoding == PositionEncoding::Quantized16
+        ? pad8(3 * n * sizeof(std::uint16_t))
+        : 3 * n * sizeof(float);
+}
+
+std::size_t chunkBytes(PositionEncoding encoding, std::size_t n) {
+    return pad8(sizeof(SnapshotFrameHeader) + positionBytes(encoding, n) + 5 * n * sizeof(float));
+}
+
+// 64-bit fseek; long is 32 bits on Windows
+bool seekTo(std::FILE* f, std::uint64_t offset) {
+#if defined(_WIN32)
+    return _fseeki64(f, (__int64)offset, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+#endif
+}
+
+template <typename Vec>
+void copyOut(const Vec& src, std::vector<float>& dst) {
+    dst.assign(src.begin(), src.end());
+}
+
+} // namespace
+
+SnapshotWriter::~SnapshotWriter() {
+    close();
+}
+
+bool SnapshotWriter::open(const std::string& path, PositionEncoding encoding) {
+    close();
+
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_)
+        return false;
+
+    SnapshotFileHeader header{};
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.encoding = (std::uint32_t)encoding;
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+
+    encoding_ = encoding;
+    offset_ = sizeof(header);
+    index_.clear();
+    backFull_ = false;
+    stop_ = false;
+    failed_ = false;
+    dropped_ = 0;
+    thread_ = std::thread([this] { writerLoop(); });
+    return true;
+}
+
+bool SnapshotWriter::submit(const BodyStore& bodies, std::uint64_t step, double time) {
+    if (!file_)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_)
+            return false;
+        if (backFull_) {
+            dropped_++;
+            return false;
+        }
+    }
+
+    // the writer thread only touches back_ after backFull_ is set
+    back_.step = step;
+    back_.time = time;
+    copyOut(bodies.x, back_.x);
+    copyOut(bodies.y, back_.y);
+    copyOut(bodies.z, back_.z);
+    copyOut(bodies.vx, back_.vx);
+    copyOut(bodies.vy, back_.vy);
+    copyOut(bodies.vz, back_.vz);
+    copyOut(bodies.mass, back_.mass);
+    copyOut(bodies.radius, back_.radius);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        backFull_ = true;
+    }
+    ready_.notify_one();
+    return true;
+}
+
+bool SnapshotWriter::close() {
+    if (!file_)
+        return !failed_;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    ready_.notify_one();
+    thread_.join();
+
+    SnapshotFooter footer{};
+    footer.indexOffset = offset_;
+    footer.frameCount = index_.size();
+    std::memcpy(footer.magic, FOOTER_MAGIC, sizeof(footer.magic));
+
+    // after a failed frame write, put the index over the partial chunk so
+    // the frames that did land stay reachable
+    bool ok = true;
+    if (failed_)
+        ok = seekTo(file_, offset_);
+    if (ok && !index_.empty())
+        ok = std::fwrite(index_.data(), sizeof(std::uint64_t), index_.size(), file_) == index_.size();
+    if (ok)
+        ok = std::fwrite(&footer, sizeof(footer), 1, file_) == 1;
+
+    if (std::fclose(file_) != 0)
+        ok = false;
+    file_ = nullptr;
+
+    if (!ok)
+        failed_ = true;
+    return !failed_;
+}
+
+bool SnapshotWriter::failed() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return failed_;
+}
+
+std::uint64_t SnapshotWriter::framesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return index_.size();
+}
+
+std::uint64_t SnapshotWriter::framesDropped() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return dropped_;
+}
+
+void SnapshotWriter::writerLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        ready_.wait(lock, [&] { return backFull_ || stop_; });
+        if (!backFull_)
+            return;
+
+        std::swap(front_, back_);
+        backFull_ = false;
+
+        lock.unlock();
+        writeFrame(front_);
+        lock.lock();
+    }
+}
+
+void SnapshotWriter::writeFrame(const Frame& frame) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (failed_)
+            return;
+    }
+
+    const std::size_t n = frame.x.size();
+    const std::size_t bytes = chunkBytes(encoding_, n);
+    chunk_.assign(bytes, 0);
+
+    SnapshotFrameHeader header{};
+    header.tag = SNAPSHOT_FRAME_TAG;
+    header.bodyCount = (std::uint32_t)n;
+    header.step = frame.step;
+    header.time = frame.time;
+    header.byteSize = bytes;
+
+    unsigned char* out = chunk_.data() + sizeof(header);
+    const std::vector<float>* pos[3] = { &frame.x, &frame.y, &frame.z };
+
+    if (encoding_ == PositionEncoding::Quantized16) {
+        std::uint16_t* q = reinterpret_cast<std::uint16_t*>(out);
+        for (int axis = 0; axis < 3; axis++) {
+            const std::vector<float>& v = *pos[axis];
+            float lo = 0.0f, hi = 0.0f;
+            if (n > 0) {
+                auto mm = std::minmax_element(v.begin(), v.end());
+                lo = *mm.first;
+                hi = *mm.second;
+            }
+            float step = hi > lo ? (hi - lo) / 65535.0f : 1.0f;
+            header.posOrigin[axis] = lo;
+            header.posStep[axis] = step;
+
+            for (std::size_t i = 0; i < n; i++) {
+                float code = std::round((v[i] - lo) / step);
+                q[axis * n + i] = (std::uint16_t)std::clamp(code, 0.0f, 65535.0f);
+            }
+        }
+    } else {
+        for (int axis = 0; axis < 3; axis++)
+            std::memcpy(out + axis * n * sizeof(float), pos[axis]->data(), n * sizeof(float));
+    }
+    out += positionBytes(encoding_, n);
+
+    const std::vector<float>* rest[5] = { &frame.vx, &frame.vy, &frame.vz, &frame.mass, &frame.radius };
+    for (const std::vector<float>* v : rest) {
+        std::memcpy(out, v->data(), n * sizeof(float));
+        out += n * sizeof(float);
+    }
+
+    std::memcpy(chunk_.data(), &header, sizeof(header));
+    if (std::fwrite(chunk_.data(), 1, bytes, file_) != bytes) {
+        // offset_ still marks the end of the last good frame; close() writes
+        // the index there
+        std::lock_guard<std::mutex> lock(mutex_);
+        failed_ = true;
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    index_.push_back(offset_);
+    offset_ += bytes;
+}
+
+bool SnapshotReader::open(const std::string& path) {
+    close();
+    if (!file_.open(path))
+        return false;
+
+    SnapshotFileHeader header;
+    if (file_.size() < sizeof(header)) {
+        close();
+        return false;
+    }
+    std::memcpy(&header, file_.data(), sizeof(header));
+    if (std::memcmp(header.magic, FILE_MAGIC, sizeof(header.magic)) != 0
+        || header.version != SNAPSHOT_VERSION
+        || header.encoding > (std::uint32_t)PositionEncoding::Quantized16)
+    {
+        close();
+        return false;
+    }
+    encoding_ = (PositionEncoding)header.encoding;
+
+    if (!readIndex())
+        scanFrames();
+    return true;
+}
+
+void SnapshotReader::close() {
+    file_.close();
+    offsets_.clear();
+}
+
+bool SnapshotReader::readIndex() {
+    const std::size_t size = file_.size();
+    if (size < sizeof(SnapshotFileHeader) + sizeof(SnapshotFooter))
+        return false;
+
+    SnapshotFooter footer;
+    std::memcpy(&footer, file_.data() + size - sizeof(footer), sizeof(footer));
+    if (std::memcmp(footer.magic, FOOTER_MAGIC, sizeof(footer.magic)) != 0)
+        return false;
+
+    const std::uint64_t indexBytes = footer.frameCount * sizeof(std::uint64_t);
+    if (footer.indexOffset + indexBytes + sizeof(footer) != size)
+        return false;
+
+    offsets_.resize(footer.frameCount);
+    if (indexBytes > 0)
+        std::memcpy(offsets_.data(), file_.data() + footer.indexOffset, indexBytes);
+    return true;
+}
+
+void SnapshotReader::scanFrames() {
+    // recovery path for files that were never closed
+    offsets_.clear();
+    std::uint64_t offset = sizeof(SnapshotFileHeader);
+    while (offset + sizeof(SnapshotFrameHeader) <= file_.size()) {
+        SnapshotFrameHeader header;
+        std::memcpy(&header, file_.data() + offset, sizeof(header));
+        if (header.tag != SNAPSHOT_FRAME_TAG
+            || header.byteSize != chunkBytes(encoding_, header.bodyCount)
+            || offset + header.byteSize > file_.size())
+            break;
+        offsets_.push_back(offset);
+        offset += header.byteSize;
+    }
+}
+
+bool SnapshotReader::readFrame(std::size_t k, BodyStore& bodies, SnapshotFrameInfo* info) const {
+    if (k >= offsets_.size())
+        return false;
+
+    const std::uint64_t offset = offsets_[k];
+    if (offset + sizeof(SnapshotFrameHeader) > file_.size())
+        return false;
+
+    SnapshotFrameHeader header;
+    std::memcpy(&header, file_.data() + offset, sizeof(header));
+    const std::size_t n = header.bodyCount;
+    if (header.tag != SNAPSHOT_FRAME_TAG
+        || header.byteSize != chunkBytes(encoding_, n)
+        || offset + header.byteSize > file_.size())
+        return false;
+
+    bodies.resize(n);
+    const unsigned char* in = file_.data() + offset + sizeof(header);
+    float* pos[3] = { bodies.x.data(), bodies.y.data(), bodies.z.data() };
+
+    if (encoding_ == PositionEncoding::Quantized16) {
+        for (int axis = 0; axis < 3; axis++) {
+            const float lo = header.posOrigin[axis];
+            const float step = header.posStep[axis];
+            for (std::size_t i = 0; i < n; i++) {
+                std::uint16_t code;
+                std::memcpy(&code, in + (axis * n + i) * sizeof(code), sizeof(code));
+                pos[axis][i] = lo + code * step;
+            }
+        }
+    } else {
+        for (int axis = 0; axis < 3; axis++)
+            std::memcpy(pos[axis], in + axis * n * sizeof(float), n * sizeof(float));
+    }
+    in += positionBytes(encoding_, n);
+
+    float* rest[5] = { bodies.vx.data(), bodies.vy.data(), bodies.vz.data(),
+                       bodies.mass.data(), bodies.radius.data() };
+    for (float* dst : rest) {
+        std::memcpy(dst, in, n * sizeof(float));
+        in += n * sizeof(float);
+    }
+    if (bodies.mixed())
+        bodies.syncDouble();
+
+    if (info)
+        *info = { header.step, header.time };
+    return true;
+}
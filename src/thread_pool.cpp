@@ -0,0 +1,120 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    for (unsigned i = 0; i < threads; i++)
+        queues_.push_back(std::make_unique<Queue>());
+
+    for (unsigned i = 1; i < threads; i++)
+        workers_.emplace_back([this, i] { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& t : workers_)
+        t.join();
+}
+
+void ThreadPool::parallelFor(std::size_t n, std::size_t grain, const RangeFn& fn) {
+    if (n == 0)
+        return;
+    if (grain == 0)
+        grain = 1;
+
+    const std::size_t chunks = (n + grain - 1) / grain;
+    if (workers_.empty() || chunks == 1) {
+        for (std::size_t begin = 0; begin < n; begin += grain)
+            fn(begin, std::min(n, begin + grain));
+        return;
+    }
+
+    Job job;
+    job.fn = &fn;
+    job.remaining.store(chunks);
+
+    // deal contiguous runs of chunks to each queue so neighbouring chunks
+    // usually stay on one core
+    const std::size_t slots = queues_.size();
+    const std::size_t perSlot = (chunks + slots - 1) / slots;
+    for (std::size_t s = 0; s < slots; s++) {
+        std::lock_guard<std::mutex> lock(queues_[s]->mutex);
+        for (std::size_t c = s * perSlot; c < std::min(chunks, (s + 1) * perSlot); c++) {
+            std::size_t begin = c * grain;
+            queues_[s]->tasks.push_back({ &job, begin, std::min(n, begin + grain) });
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        pending_.fetch_add(chunks);
+    }
+    wake_.notify_all();
+
+    Task task;
+    while (job.remaining.load() > 0) {
+        if (tryPop(0, task) || trySteal(0, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        done_.wait(lock, [&] { return job.remaining.load() == 0; });
+    }
+}
+
+void ThreadPool::workerLoop(std::size_t index) {
+    Task task;
+    while (true) {
+        if (tryPop(index, task) || trySteal(index, task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [&] { return stop_ || pending_.load() > 0; });
+        if (stop_)
+            return;
+    }
+}
+
+bool ThreadPool::tryPop(std::size_t index, Task& out) {
+    Queue& q = *queues_[index];
+    std::lock_guard<std::mutex> lock(q.mutex);
+    if (q.tasks.empty())
+        return false;
+    out = q.tasks.front();
+    q.tasks.pop_front();
+    pending_.fetch_sub(1);
+    return true;
+}
+
+bool ThreadPool::trySteal(std::size_t index, Task& out) {
+    const std::size_t slots = queues_.size();
+    for (std::size_t k = 1; k < slots; k++) {
+        Queue& q = *queues_[(index + k) % slots];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty())
+            continue;
+        out = q.tasks.back();
+        q.tasks.pop_back();
+        pending_.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(const Task& task) {
+    (*task.job->fn)(task.begin, task.end);
+    if (task.job->remaining.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        done_.notify_all();
+    }
+}
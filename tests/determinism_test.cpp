@@ -0,0 +1,53 @@
+// Forces and trajectories must be bit-identical for any thread count:
+// steps the same scenario with 1 and N workers and compares the arrays
+// exactly, for every solver.
+
+#include <cstdio>
+#include <cstring>
+
+#include "scenario.hpp"
+#include "simulation.hpp"
+
+namespace {
+
+constexpr std::size_t BODIES = 3000;
+constexpr int STEPS = 3;
+constexpr float DT = 0.001f;
+
+bool sameArray(const AlignedVector<float>& a, const AlignedVector<float>& b) {
+    return a.size() == b.size()
+        && std::memcmp(a.data(), b.data(), a.size() * sizeof(float)) == 0;
+}
+
+void run(Simulation& sim, Solver solver) {
+    sim.setSolver(solver);
+    makePlummer(sim.bodies(), BODIES, 7, sim.gravity());
+    for (int s = 0; s < STEPS; s++)
+        sim.step(DT);
+}
+
+bool check(Solver solver, unsigned threads) {
+    Simulation serial(1), parallel(threads);
+    run(serial, solver);
+    run(parallel, solver);
+
+    const BodyStore& a = serial.bodies();
+    const BodyStore& b = parallel.bodies();
+    const bool same = sameArray(a.ax, b.ax) && sameArray(a.ay, b.ay) && sameArray(a.az, b.az)
+                   && sameArray(a.x, b.x) && sameArray(a.y, b.y) && sameArray(a.z, b.z);
+
+    std::printf("%-14s 1 vs %u threads: %s\n", solverName(solver), threads, same ? "ok" : "MISMATCH");
+    return same;
+}
+
+} // namespace
+
+int main()
+{
+    bool ok = true;
+    for (Solver solver : { Solver::Direct, Solver::BarnesHut, Solver::ParticleMesh }) {
+        for (unsigned threads : { 2u, 5u, 8u })
+            ok = check(solver, threads) && ok;
+    }
+    return ok ? 0 : 1;
+}